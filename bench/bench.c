@@ -0,0 +1,254 @@
+// Host micro-benchmarks for the engine: make bench
+//
+// Each benchmark runs a fixed number of operations per trial and reports
+// the fastest and the median of TRIALS trials in nanoseconds per operation,
+// so repeated runs on an idle machine agree to a few percent.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "platform.h"
+#include "engine.h"
+
+#define TRIALS      7
+#define SHEET_ROWS  100     // rows in the sheet used by the load and save benchmarks
+
+typedef void (*PFN_BENCH)(uint32_t ops);
+
+const char* bench_file;   // sheet saved or loaded by bench_save and bench_load
+
+void error(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void status(const char* fmt, ...) {
+    (void)fmt;
+}
+
+void mark_changed(Cell* c) {
+    (void)c;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(const char* name, void (*setup)(void), PFN_BENCH bench, uint32_t ops) {
+    double t[TRIALS];
+    for (int i = 0; i < TRIALS; i++) {
+        if (setup) setup();
+        double start = now_ns();
+        bench(ops);
+        t[i] = (now_ns() - start) / ops;
+    }
+    qsort(t, TRIALS, sizeof(t[0]), cmp_double);
+    printf("%-20s %12.1f ns/op  (median %.1f, %u ops x %d)\n", name, t[0], t[TRIALS / 2], ops, TRIALS);
+}
+
+/* Sheets */
+
+static void clear_sheet(void) {
+    free_cells();
+}
+
+// A1 = 1, An = A(n-1) + 1
+static void setup_chain(void) {
+    char buf[16];
+    clear_sheet();
+    set_cell(0, 0, "1");
+    for (int r = 1; r < MAX_ROWS; r++) {
+        sprintf(buf, "=A%d+1", r);
+        set_cell(0, r, buf);
+    }
+}
+
+// A1 = 1, Bn..Dn = $A1 * n
+static void setup_fanout(void) {
+    char buf[16];
+    clear_sheet();
+    set_cell(0, 0, "1");
+    for (int c = 1; c < 4; c++) {
+        for (int r = 0; r < MAX_ROWS; r++) {
+            sprintf(buf, "=A1*%d", r);
+            set_cell(c, r, buf);
+        }
+    }
+}
+
+// A1..A256 numbers
+static void setup_column(void) {
+    char buf[16];
+    clear_sheet();
+    for (int r = 0; r < MAX_ROWS; r++) {
+        sprintf(buf, "%d", r);
+        set_cell(0, r, buf);
+    }
+}
+
+// SHEET_ROWS rows of numbers, text and formulas across every column
+static void setup_mixed(void) {
+    char buf[32];
+    clear_sheet();
+    for (int r = 0; r < SHEET_ROWS; r++) {
+        for (int c = 0; c < MAX_COLS; c++) {
+            switch (c % 4) {
+                case 0: sprintf(buf, "%d.5", r * c); break;
+                case 1: sprintf(buf, "=%c%d*2", 'A' + c - 1, r + 1); break;
+                case 2: sprintf(buf, "'Item %d", r); break;
+                case 3: sprintf(buf, "=SUM(A%d:%c%d)", r + 1, 'A' + c - 1, r + 1); break;
+            }
+            set_cell(c, r, buf);
+        }
+    }
+}
+
+/* Benchmarks */
+
+static const char* formulas[] = {
+    "A1+B2*3-SUM(A1:A10)/2",
+    "IF(A1>B1,A1,B1)",
+    "SQRT(ABS(C5))+LOG10(100)*(D4-2.5E3)",
+    "\"Total: \"+AVG(B1:B256)",
+};
+#define FORMULA_COUNT (sizeof(formulas) / sizeof(formulas[0]))
+
+static void bench_tokenize(uint32_t ops) {
+    char buf[64];
+    for (uint32_t i = 0; i < ops; i++) {
+        strcpy(buf, formulas[i % FORMULA_COUNT]);
+        expr = buf;
+        next_char();
+        get_token();
+        while (tok_type != tokEnd && tok_type != tokError) get_token();
+    }
+}
+
+static void bench_eval(uint32_t ops) {
+    static const char* exprs[] = { "1+2*3-4/5", "A1*2+A2", "SQRT(ABS(A3))+LOG10(100)", "IF(A1>A2,A1,A2)" };
+    char buf[64];
+    for (uint32_t i = 0; i < ops; i++) {
+        strcpy(buf, exprs[i % 4]);
+        Value v = parse_expr(buf);
+        free_val(&v);
+    }
+}
+
+// Each edit changes the head of a long chain or the source of a fan-out
+static void bench_edit_a1(uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) set_cell(0, 0, i & 1 ? "2" : "3");
+}
+
+static void bench_sum(uint32_t ops) {
+    char buf[16];
+    for (uint32_t i = 0; i < ops; i++) {
+        strcpy(buf, i & 1 ? "SUM(A1:A256)" : "MAX(A1:A256)");
+        Value v = parse_expr(buf);
+        free_val(&v);
+    }
+}
+
+static void bench_save(uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) {
+        strcpy(filename, bench_file);
+        e_filename = filename;
+        if (do_save()) error("save failed");
+    }
+}
+
+// The number of writes esxDOS would see for one save, the host cannot time them
+static void count_writes(const char* name, void (*setup)(void)) {
+    setup();
+    write_calls = 0;
+    bench_save(1);
+    printf("%-20s %12u writes/save\n", name, write_calls);
+}
+
+static void bench_load(uint32_t ops) {
+    for (uint32_t i = 0; i < ops; i++) {
+        free_cells();
+        strcpy(filename, bench_file);
+        e_filename = filename;
+        if (load_open(filename, MAX_ROWS)) while (load_more(UINT16_MAX));
+        load_end();
+    }
+}
+
+static void setup_loaded(void) {
+    bench_load(1);
+}
+
+static void setup_text(void) {
+    bench_file = "/tmp/zxsheet_bench.zsc";
+    setup_mixed();
+}
+
+static void setup_binary(void) {
+    bench_file = "/tmp/zxsheet_bench.zsb";
+    setup_mixed();
+}
+
+static void setup_text_file(void) {
+    setup_text();
+    bench_save(1);
+}
+
+static void setup_binary_file(void) {
+    setup_binary();
+    bench_save(1);
+}
+
+// bench sheet.zsc...: time loading each sheet and changing A1 in it
+static void bench_files(int count, char* files[]) {
+    for (int i = 0; i < count; i++) {
+        bench_file = files[i];
+        printf("%s\n", bench_file);
+        run("  load", NULL, bench_load, 5);
+        run("  edit A1", setup_loaded, bench_edit_a1, 20);
+    }
+    free_cells();
+}
+
+int main(int argc, char* argv[]) {
+    engine_init();
+    init();
+
+    if (argc > 1) {
+        bench_files(argc - 1, argv + 1);
+        cleanup();
+        return 0;
+    }
+
+    setup_column();
+    run("tokenize", NULL, bench_tokenize, 100000);
+    run("eval", NULL, bench_eval, 100000);
+    run("range sum/max 256", NULL, bench_sum, 2000);
+    run("recalc chain 256", setup_chain, bench_edit_a1, 200);
+    run("recalc fanout 768", setup_fanout, bench_edit_a1, 200);
+    run("save text 2600", setup_text, bench_save, 20);
+    run("save binary 2600", setup_binary, bench_save, 20);
+    count_writes("save text 2600", setup_text);
+    count_writes("save binary 2600", setup_binary);
+    run("load text 2600", setup_text_file, bench_load, 20);
+    run("load binary 2600", setup_binary_file, bench_load, 20);
+
+    remove("/tmp/zxsheet_bench.zsc");
+    remove("/tmp/zxsheet_bench.zsb");
+    free_cells();
+    cleanup();
+    return 0;
+}
@@ -0,0 +1,161 @@
+// crtio.h drawing into a memory tilemap, for the z88dk-ticks scenarios.
+// Same layout as the back buffer in crtio.c (character - 32, attribute),
+// with memcpy in place of the DMA and no keyboard, caret or display.
+
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "platform.h"
+#include "crtio.h"
+
+#define MAP_SIZE        ((SCREEN_WIDTH * SCREEN_HEIGHT) * 2)
+#define ROW_SIZE        (SCREEN_WIDTH * 2)
+
+char tile_back[MAP_SIZE];
+char * const screen = tile_back;
+
+uint8_t cx = 0;         // caret X
+uint8_t cy = 0;         // caret Y
+uint8_t attr = 0;       // current attribute
+
+void screen_init(void) MYCC {
+    cls();
+}
+
+void screen_restore(void) MYCC {
+}
+
+void screen_flip(void) MYCC {
+}
+
+void show_caret(void) MYCC {
+}
+
+void hide_caret(void) MYCC {
+}
+
+void toggle_caret(void) MYCC {
+}
+
+void cls(void) MYCC {
+    memset(screen, 0, MAP_SIZE);
+    cx = 0;
+    cy = 0;
+}
+
+void clreol(void) MYCC {
+    char * p = screen + (((cy * SCREEN_WIDTH) + cx) << 1);
+    for (uint8_t x = cx; x < SCREEN_WIDTH; ++x) {
+        *p++ = 0;
+        *p++ = attr;
+    }
+}
+
+void move_rows(uint8_t dst, uint8_t src, uint8_t count) MYCC {
+    memmove(screen + dst * ROW_SIZE, screen + src * ROW_SIZE, count * ROW_SIZE);
+}
+
+void move_cols(uint8_t dst, uint8_t src, uint8_t width, uint8_t top, uint8_t count) MYCC {
+    char * p = screen + top * ROW_SIZE;
+    for (; count; --count, p += ROW_SIZE) {
+        memmove(p + (dst << 1), p + (src << 1), width << 1);
+    }
+}
+
+void putch(char ch) MYCC {
+    if (ch == NL) {
+        if (cy < SCREEN_HEIGHT-1) ++cy;
+        else move_rows(0, 1, SCREEN_HEIGHT-1);
+        cx = 0;
+        return;
+    }
+    if (ch < 32 || ch > 128) ch = 128;
+
+    if (cx > SCREEN_WIDTH-1) {
+        if (cy < SCREEN_HEIGHT-1) ++cy;
+        else move_rows(0, 1, SCREEN_HEIGHT-1);
+        cx = 0;
+    }
+    char * p = screen + (((cy * SCREEN_WIDTH) + cx) << 1);
+    *p++ = ch - 32;
+    *p = attr;
+    ++cx;
+}
+
+void putch_at(uint8_t x, uint8_t y, char ch) MYCC {
+    if (x >= SCREEN_WIDTH) x = SCREEN_WIDTH-1;
+    if (y >= SCREEN_HEIGHT) y = SCREEN_HEIGHT-1;
+    char * p = screen + (((y * SCREEN_WIDTH) + x) << 1);
+    *p++ = ch - 32;
+    *p = attr;
+}
+
+void print(const char *fmt, ...) MYCC {
+    static char buf[128];
+    va_list v;
+    va_start(v, fmt);
+    vsnprintf(buf, sizeof(buf), (char*)fmt, v);
+    va_end(v);
+    prints(buf);
+}
+
+void prints(const char* str) MYCC {
+    while (*str) {
+        putch(*str++);
+    }
+}
+
+void tile_puts(const char *s) MYCC {
+    char * p = screen + (((cy * SCREEN_WIDTH) + cx) << 1);
+    for (; *s && cx < SCREEN_WIDTH; ++cx) {
+        *p++ = *s++ - 32;
+        *p++ = attr;
+    }
+}
+
+void tile_field(uint8_t width, const char *s) MYCC {
+    char * p = screen + (((cy * SCREEN_WIDTH) + cx) << 1);
+    for (; width && cx < SCREEN_WIDTH; --width, ++cx) {
+        *p++ = *s ? *s++ - 32 : 0;
+        *p++ = attr;
+    }
+}
+
+// There is no keyboard, anything waiting for a key is cancelled
+char getch(void) MYCC {
+    return KEY_ESC;
+}
+
+uint8_t kbhit(void) MYCC {
+    return 0;
+}
+
+void set_cursor_pos(uint8_t x, uint8_t y) MYCC {
+    if (x >= SCREEN_WIDTH) x = SCREEN_WIDTH-1;
+    if (y >= SCREEN_HEIGHT) y = SCREEN_HEIGHT-1;
+    cx = x;
+    cy = y;
+}
+
+void get_cursor_pos(uint8_t *x, uint8_t *y) MYCC {
+    *x = cx;
+    *y = cy;
+}
+
+void highlight(void) MYCC {
+    attr = 0b00010000;
+}
+
+void standard(void) MYCC {
+    attr = 0b00000000;
+}
+
+uint16_t get_ticks(void) MYCC {
+    return 0;
+}
+
+uint8_t edit_line(const char* prompt, const char* alphabet, char* buffer, uint8_t maxlen) MYCC {
+    return 0;
+}
@@ -0,0 +1,126 @@
+// Z80 cycle counts for canned scenarios: make ticks
+//
+// Built with main.c (less its main), crtio_mem.c and ticks_platform.c, one
+// binary per scenario selected with -DSCENARIO=\"name\". z88dk-ticks counts
+// the T-states from ticks_start to ticks_stop, setup is not included.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+#include "crtio.h"
+#include "engine.h"
+
+#define LOAD_ROWS   64      // rows in the sheet saved and reloaded by the load scenario
+
+typedef struct Scenario {
+    const char* name;
+    void (*setup)(void);
+    void (*run)(void);
+} Scenario;
+
+void print_view(void);
+
+char sum_expr[16];
+
+// z88dk-ticks is given these as -start and -end, keep them out of line
+void ticks_start(void) {
+}
+
+void ticks_stop(void) {
+}
+
+/* Sheets */
+
+// A1 = 1, An = A(n-1) + 1
+void setup_chain(void) {
+    char buf[16];
+    set_cell(0, 0, "1");
+    for (int r = 1; r < MAX_ROWS; r++) {
+        sprintf(buf, "=A%d+1", r);
+        set_cell(0, r, buf);
+    }
+}
+
+// A1..A256 numbers
+void setup_column(void) {
+    char buf[16];
+    for (int r = 0; r < MAX_ROWS; r++) {
+        sprintf(buf, "%d", r);
+        set_cell(0, r, buf);
+    }
+    strcpy(sum_expr, "SUM(A1:A256)");
+}
+
+// rows of numbers, text and formulas across the first columns
+void setup_mixed(int rows) {
+    char buf[24];
+    for (int r = 0; r < rows; r++) {
+        sprintf(buf, "%d.5", r);
+        set_cell(0, r, buf);
+        sprintf(buf, "=A%d*2", r + 1);
+        set_cell(1, r, buf);
+        sprintf(buf, "'Item %d", r);
+        set_cell(2, r, buf);
+        sprintf(buf, "=SUM(A%d:B%d)", r + 1, r + 1);
+        set_cell(3, r, buf);
+        sprintf(buf, "%d", r * 7);
+        set_cell(4, r, buf);
+        sprintf(buf, "=IF(E%d>100,E%d,0)", r + 1, r + 1);
+        set_cell(5, r, buf);
+    }
+}
+
+void setup_load(void) {
+    setup_mixed(LOAD_ROWS);
+    strcpy(filename, "bench.zsc");
+    e_filename = filename;
+    do_save();
+    free_cells();
+}
+
+void setup_render(void) {
+    setup_mixed(24);
+}
+
+/* Scenarios */
+
+void run_load(void) {
+    if (load_open(filename, MAX_ROWS)) while (load_more(UINT16_MAX));
+    load_end();
+}
+
+void run_edit(void) {
+    set_cell(0, 0, "2");
+}
+
+void run_sum(void) {
+    Value v = parse_expr(sum_expr);
+    free_val(&v);
+}
+
+const Scenario scenarios[] = {
+    { "load", setup_load, run_load },
+    { "edit", setup_chain, run_edit },
+    { "sum", setup_column, run_sum },
+    { "render", setup_render, print_view },
+};
+
+int main(void) {
+    engine_init();
+    init();
+    screen_init();
+
+    for (uint8_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i) {
+        const Scenario* s = &scenarios[i];
+        if (strcmp(s->name, SCENARIO) != 0) continue;
+        s->setup();
+        ticks_start();
+        s->run();
+        ticks_stop();
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,32 @@
+# make ticks: compare the counts in output/ticks.txt with bench/ticks_baseline.txt
+# Both hold "scenario T-states" lines, '#' starts a comment. Exits 1 if any
+# scenario is missing a count or a baseline, or is more than limit percent
+# over its baseline.
+
+$1 ~ /^#/ || NF == 0 { next }
+
+FILENAME == ARGV[1] { base[$1] = $2; counts++; next }
+
+!counts && !warned++ {
+    print "NO BASELINE: ticks_baseline.txt has no counts, record them with make ticks-baseline"
+}
+
+NF < 2 {
+    printf "%-8s %10s  no count, did z88dk-ticks run?\n", $1, "-"
+    failed = 1
+    next
+}
+
+!($1 in base) {
+    printf "%-8s %10d  NO BASELINE\n", $1, $2
+    failed = 1
+    next
+}
+
+{
+    pct = ($2 - base[$1]) * 100.0 / base[$1]
+    printf "%-8s %10d  %+6.2f%%%s\n", $1, $2, pct, (pct > limit ? "  REGRESSION" : "")
+    if (pct > limit) failed = 1
+}
+
+END { exit failed }
@@ -0,0 +1,139 @@
+// platform.h on memory files, for the z88dk-ticks scenarios. Saves and
+// loads run the real stream and format code but never leave RAM, so the
+// counts do not depend on how the emulator does I/O.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "platform.h"
+
+#define MEM_FILES       4
+#define MEM_NAME_LEN    24
+
+typedef struct MemFile {
+    char name[MEM_NAME_LEN];
+    char* data;
+    uint16_t size;
+    uint16_t pos;
+    uint8_t used;
+} MemFile;
+
+MemFile mem_files[MEM_FILES];
+
+char filename_buffer[261];
+char *filename = &filename_buffer[0];
+char tmpbuffer[256];
+
+static char block[BLOCK_SIZE];
+
+void cleanup(void) {
+    for (uint8_t i = 0; i < MEM_FILES; ++i) free(mem_files[i].data);
+    memset(mem_files, 0, sizeof(mem_files));
+}
+
+void init(void) {
+}
+
+const char* get_lfn(const char* filepath) {
+    strncpy(filename, filepath, 250);
+    filename[250] = 0;
+    return &filename[0];
+}
+
+MemFile* mem_find(const char* name) {
+    for (uint8_t i = 0; i < MEM_FILES; ++i) {
+        if (mem_files[i].used && strcmp(mem_files[i].name, name) == 0) return &mem_files[i];
+    }
+    return NULL;
+}
+
+void* open_file(const char* filename) {
+    MemFile* f = mem_find(filename);
+    if (!f) {
+        errno = ENOENT;
+        return NULL;
+    }
+    f->pos = 0;
+    return f;
+}
+
+void* create_file(const char* filename) {
+    MemFile* f = mem_find(filename);
+    for (uint8_t i = 0; !f && i < MEM_FILES; ++i) {
+        if (!mem_files[i].used) f = &mem_files[i];
+    }
+    if (!f || strlen(filename) >= MEM_NAME_LEN) {
+        errno = ENOSPC;
+        return NULL;
+    }
+    strcpy(f->name, filename);
+    f->used = 1;
+    f->size = 0;
+    f->pos = 0;
+    return f;
+}
+
+void* append_file(const char* filename) {
+    MemFile* f = mem_find(filename);
+    if (!f) f = create_file(filename);
+    if (f) f->pos = f->size;
+    return f;
+}
+
+void delete_file(const char* filename) {
+    MemFile* f = mem_find(filename);
+    if (f) {
+        free(f->data);
+        memset(f, 0, sizeof(MemFile));
+    }
+}
+
+uint32_t file_size(void* file) {
+    return file ? ((MemFile*)file)->size : 0;
+}
+
+void close_file(void* file) {
+}
+
+int read_file(void* file, char* buffer, size_t size) {
+    MemFile* f = file;
+    if (!f) return 0;
+    if (size > f->size - f->pos) size = f->size - f->pos;
+    memcpy(buffer, f->data + f->pos, size);
+    f->pos += size;
+    return size;
+}
+
+int write_file(void* file, const char* buffer, size_t size) {
+    MemFile* f = file;
+    if (!f) return 0;
+    char* data = realloc(f->data, f->pos + size);
+    if (!data) {
+        errno = ENOSPC;
+        return 0;
+    }
+    f->data = data;
+    memcpy(f->data + f->pos, buffer, size);
+    f->pos += size;
+    if (f->pos > f->size) f->size = f->pos;
+    return size;
+}
+
+void rename_file(const char* oldname, const char* newname) {
+    MemFile* f = mem_find(oldname);
+    if (!f || strlen(newname) >= MEM_NAME_LEN) {
+        errno = ENOENT;
+        return;
+    }
+    delete_file(newname);
+    strcpy(f->name, newname);
+}
+
+char* block_map(void) {
+    return block;
+}
+
+void block_unmap(void) {
+}
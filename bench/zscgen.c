@@ -0,0 +1,164 @@
+// Synthetic sheets for stress and scaling tests, see bench/README.md
+//
+//   zscgen <shape> [size] [arg] > sheet.zsc
+//
+// Writes the sorted text format do_save writes: the header, then one
+// A1:content line per cell in row-major order. Numbers are plain, as
+// typed, where do_save would write them as =n.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "engine.h"
+
+#define EST_CELL_BYTES  56  // rough Z80 heap cost of a one-reference formula cell
+
+typedef struct Shape {
+    const char* name;
+    int size;               // default size
+    int arg;                // default extra parameter, 0 if none
+    void (*make)(int size, int arg);
+    const char* help;
+} Shape;
+
+char* grid[MAX_ROWS][MAX_COLS];
+
+void put(int col, int row, const char* fmt, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    if (col < 0 || col >= MAX_COLS || row < 0 || row >= MAX_ROWS) {
+        fprintf(stderr, "zscgen: %c%d is outside the sheet, use a smaller size\n", 'A' + col, row + 1);
+        exit(1);
+    }
+    free(grid[row][col]);
+    grid[row][col] = strdup(buf);
+}
+
+void check_cells(int cells, int room) {
+    if (cells > room) {
+        fprintf(stderr, "zscgen: %d cells do not fit, at most %d\n", cells, room);
+        exit(1);
+    }
+}
+
+/* Shapes */
+
+// A1 = 1 and every next cell adds one to the previous, down A then on down B...
+void make_chain(int size, int arg) {
+    check_cells(size, MAX_ROWS * MAX_COLS);
+    put(0, 0, "1");
+    for (int i = 1; i < size; ++i) {
+        put(i / MAX_ROWS, i % MAX_ROWS, "=%c%d+1", 'A' + (i - 1) / MAX_ROWS, (i - 1) % MAX_ROWS + 1);
+    }
+}
+
+// A1 referenced by size formulas filling B1:Z
+void make_fanout(int size, int arg) {
+    check_cells(size, MAX_ROWS * (MAX_COLS - 1));
+    put(0, 0, "1");
+    for (int i = 0; i < size; ++i) {
+        put(1 + i % (MAX_COLS - 1), i / (MAX_COLS - 1), "=A1+%d", i + 1);
+    }
+}
+
+// size rows of arg columns of numbers
+void make_dense(int size, int arg) {
+    for (int r = 0; r < size; ++r) {
+        for (int c = 0; c < arg; ++c) {
+            put(c, r, "%d.25", r * arg + c);
+        }
+    }
+}
+
+// size numbers in A, B sums a sliding window of arg rows, C a running total
+void make_ranges(int size, int arg) {
+    for (int r = 0; r < size; ++r) {
+        int to = r + arg < size ? r + arg : size;
+        put(0, r, "%d", r + 1);
+        put(1, r, "=SUM(A%d:A%d)", r + 1, to);
+        put(2, r, "=SUM(A1:A%d)", r + 1);
+    }
+}
+
+// size cells of text arg characters long, every fifth column joins the two before it
+void make_strings(int size, int arg) {
+    static const char* words[] = { "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel" };
+    char buf[256];
+    if (arg > 200) arg = 200;
+    check_cells(size, MAX_ROWS * MAX_COLS);
+    for (int i = 0; i < size; ++i) {
+        int c = i % MAX_COLS, r = i / MAX_COLS;
+        if (c % 5 == 4) {
+            put(c, r, "=%c%d+%c%d", 'A' + c - 2, r + 1, 'A' + c - 1, r + 1);
+            continue;
+        }
+        int len = 0;
+        for (int w = i; len < arg; ++w) {
+            len += snprintf(buf + len, sizeof(buf) - len, "%s%s", len ? " " : "", words[w % 8]);
+        }
+        int n = arg;
+        while (buf[n - 1] == ' ') --n; // trailing blanks are trimmed when loaded
+        buf[n] = 0;
+        put(c, r, "%s", buf);
+    }
+}
+
+// about size KB of heap: rows of a number followed by formulas adding to the cell on the left
+void make_heap(int size, int arg) {
+    int cells = (int)((long)size * 1024 / EST_CELL_BYTES);
+    check_cells(cells, MAX_ROWS * MAX_COLS);
+    for (int i = 0; i < cells; ++i) {
+        int c = i % MAX_COLS, r = i / MAX_COLS;
+        if (c == 0) put(c, r, "%d", r);
+        else put(c, r, "=%c%d+1", 'A' + c - 1, r + 1);
+    }
+}
+
+const Shape shapes[] = {
+    { "chain",   256, 0,  make_chain,   "size cells, each referencing the one before" },
+    { "fanout",  500, 0,  make_fanout,  "size formulas all referencing A1" },
+    { "dense",   256, 26, make_dense,   "size rows by arg columns of numbers" },
+    { "ranges",  256, 16, make_ranges,  "size rows of overlapping SUMs, windows of arg rows" },
+    { "strings", 1024, 24, make_strings, "size text cells of arg characters" },
+    { "heap",    32,  0,  make_heap,    "about size KB of Z80 heap in formula cells" },
+};
+#define SHAPE_COUNT (sizeof(shapes) / sizeof(shapes[0]))
+
+void usage(void) {
+    fprintf(stderr, "usage: zscgen <shape> [size] [arg] > sheet.zsc\n\n");
+    for (size_t i = 0; i < SHAPE_COUNT; ++i) {
+        fprintf(stderr, "  %-8s %s (size %d", shapes[i].name, shapes[i].help, shapes[i].size);
+        if (shapes[i].arg) fprintf(stderr, ", arg %d", shapes[i].arg);
+        fprintf(stderr, ")\n");
+    }
+    exit(2);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) usage();
+
+    const Shape* shape = NULL;
+    for (size_t i = 0; i < SHAPE_COUNT; ++i) {
+        if (strcmp(argv[1], shapes[i].name) == 0) shape = &shapes[i];
+    }
+    if (!shape) usage();
+
+    int size = argc > 2 ? atoi(argv[2]) : shape->size;
+    int arg = argc > 3 ? atoi(argv[3]) : shape->arg;
+    if (size <= 0 || (shape->arg && arg <= 0)) usage();
+    shape->make(size, arg);
+
+    printf("#ZSC sorted\r\n");
+    for (int r = 0; r < MAX_ROWS; ++r) {
+        for (int c = 0; c < MAX_COLS; ++c) {
+            if (grid[r][c]) printf("%c%d:%s\r\n", 'A' + c, r + 1, grid[r][c]);
+        }
+    }
+    return 0;
+}
@@ -3,22 +3,35 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <intrinsic.h>
+#include <im2.h>
 #include <z80.h>
 #include <arch/zxn.h>
 
 #include "platform.h"
+#include "dma.h"
 #include "font.h"
 #include "crtio.h"
+#include "replay.h"
 
 #define REPEAT_DELAY 20
 #define REPEAT_RATE  2
 
+#define KEY_QUEUE_SIZE  16      // type-ahead, must be a power of 2
+#define KEY_QUEUE_MASK  (KEY_QUEUE_SIZE - 1)
+
+// IM2 vector table (257 bytes on a page boundary) plus the JP to the ISR
+// at the address both vector bytes point to, somewhere in the next page
+#define IM2_SPACE       (255 + 257 + 256 + 3)
+
 #define START_BANKS     0x4000
 #define START_MAP       0x4000
 #define START_TILE_DEF  0x5400      // After 80x32 timemap with attributes
 #define OFFSET_MAP      ((START_MAP - START_BANKS) >> 8)
 #define OFFSET_TILES    ((START_TILE_DEF - START_BANKS) >> 8)
 
+#define MAP_SIZE        ((SCREEN_WIDTH * SCREEN_HEIGHT) * 2)
+#define ROW_SIZE        (SCREEN_WIDTH * 2)
+
 extern uint8_t kbstate[];
 const uint8_t unshifted [] = {
     'a','s','d','f','g',
@@ -64,7 +77,14 @@ const uint8_t ext[] = {
     0xff,    'z'|0x80,'x'|0x80,'c'|0x80,'v'|0x80,
 };
 
-char * const screen = (char * const)START_MAP;
+// All drawing goes to the back buffer, screen_flip copies the rows that
+// changed to the visible tilemap during vertical blank
+char tile_back[MAP_SIZE];
+char * const screen = tile_back;
+char * const front = (char * const)START_MAP;
+
+uint8_t dirty_top = SCREEN_HEIGHT;  // changed rows, none when top > bottom
+uint8_t dirty_bottom = 0;
 
 uint8_t old_reg_4b;
 uint8_t old_reg_6b;
@@ -77,7 +97,13 @@ uint8_t cy = 0;         // caret Y
 uint8_t attr = 0;       // current attribute
 uint8_t capslock = 0;   // is caplock engaged
 
-uint16_t ticks;         // internal ticker to track
+volatile uint16_t ticks;    // frames since start, counted by the ISR
+
+char key_queue[KEY_QUEUE_SIZE];
+volatile uint8_t key_head = 0;  // written by the ISR
+volatile uint8_t key_tail = 0;  // written by getch
+
+uint8_t im2_space[IM2_SPACE];
 
 uint8_t caret_state[] = {
     0,              // 0x35 - X
@@ -92,6 +118,29 @@ extern void kbd_scan(void) MYCC;
 extern void setup_caret_sprite(void) MYCC;
 void position_caret(void) MYCC;
 void update_caret(void) MYCC;
+void kbd_init(void) MYCC;
+void kbd_shutdown(void) MYCC;
+
+void mark_rows(uint8_t top, uint8_t bottom) MYCC {
+    if (top < dirty_top) dirty_top = top;
+    if (bottom > dirty_bottom) dirty_bottom = bottom;
+}
+
+#ifdef PROFILE
+/* Copy the whole back buffer to the tilemap, with the DMA or with memcpy */
+void flip_all(uint8_t use_dma) MYCC {
+    if (use_dma) dma_copy(front, screen, MAP_SIZE);
+    else memcpy(front, screen, MAP_SIZE);
+}
+#endif
+
+void screen_flip(void) MYCC {
+    if (dirty_top > dirty_bottom) return;
+    intrinsic_halt();
+    dma_copy(front + dirty_top * ROW_SIZE, screen + dirty_top * ROW_SIZE, (dirty_bottom - dirty_top + 1) * ROW_SIZE);
+    dirty_top = SCREEN_HEIGHT;
+    dirty_bottom = 0;
+}
 
 void screen_init(void) MYCC {
     cx = 0;
@@ -143,16 +192,19 @@ void screen_init(void) MYCC {
         ZXN_NEXTREG(0x38, 0);
     }
 
-    memcpy((void*)START_TILE_DEF, &font_crtio[0], sizeof(font_crtio));
+    dma_copy((void*)START_TILE_DEF, &font_crtio[0], sizeof(font_crtio));
     
     setup_caret_sprite();
     update_caret();
     show_caret();
     cls();
+    screen_flip();
+    kbd_init();
 }
 
 void screen_restore(void) MYCC {
-    memset((void*)START_MAP, 0, 6144);
+    kbd_shutdown();
+    dma_fill((void*)START_MAP, 0, 6144);
     hide_caret();
     ZXN_NEXTREGA(0x6b, old_reg_6b);
     ZXN_NEXTREGA(0x15, old_reg_15);
@@ -161,13 +213,28 @@ void screen_restore(void) MYCC {
 }
 
 void cls(void) MYCC {
-    memset(screen, 0, (SCREEN_WIDTH * SCREEN_HEIGHT)*2);
+    dma_fill(screen, 0, MAP_SIZE);
+    mark_rows(0, SCREEN_HEIGHT-1);
     cx=0;
     cy=0;
 }
 
 void scroll_up(void) {
-    memmove(screen, screen + (SCREEN_WIDTH<<1), (SCREEN_WIDTH*(SCREEN_HEIGHT-1)<<1));    
+    dma_copy(screen, screen + (SCREEN_WIDTH<<1), (SCREEN_WIDTH*(SCREEN_HEIGHT-1)<<1));
+    mark_rows(0, SCREEN_HEIGHT-1);
+}
+
+void move_rows(uint8_t dst, uint8_t src, uint8_t count) MYCC {
+    dma_copy(screen + ((dst * SCREEN_WIDTH) << 1), screen + ((src * SCREEN_WIDTH) << 1), (count * SCREEN_WIDTH) << 1);
+    mark_rows(dst, dst + count - 1);
+}
+
+void move_cols(uint8_t dst, uint8_t src, uint8_t width, uint8_t top, uint8_t count) MYCC {
+    char * p = screen + ((top * SCREEN_WIDTH) << 1);
+    mark_rows(top, top + count - 1);
+    for (; count; --count, p += SCREEN_WIDTH << 1) {
+        dma_copy(p + (dst << 1), p + (src << 1), width << 1);
+    }
 }
 
 void putch(char ch) MYCC {
@@ -196,6 +263,7 @@ void putch(char ch) MYCC {
     char * p = screen+(((cy*SCREEN_WIDTH) + cx) << 1);
     *p++ = ch - 32;
     *p = attr;
+    mark_rows(cy, cy);
     ++cx;  
 }
 
@@ -205,12 +273,7 @@ void putch_at(uint8_t x, uint8_t y, char ch) MYCC {
     char * p = screen+(((y*SCREEN_WIDTH) + x) << 1);
     *p++ = ch - 32;
     *p = attr;
-}
-
-void clreol(void) MYCC {
-    if (cx > SCREEN_WIDTH-1) return;
-    char * p = screen+(((cy*SCREEN_WIDTH) + cx) << 1);
-    memset(p, 0, (SCREEN_WIDTH - cx) << 1);    
+    mark_rows(y, y);
 }
 
 void print(const char *fmt, ...) MYCC {
@@ -252,45 +315,95 @@ char kbhandler(void) MYCC {
     return 0;  
 }
 
-char getch(void) MYCC {
+/* Key-repeat and capslock handling, returns the key to queue or 0 */
+char kbd_repeat(void) MYCC {
     static char lastkey = 0;
-    static uint8_t repeating = 0;
     static uint8_t repeat_delay = 0;
-    position_caret();
-    for(;;) {
-        intrinsic_halt();
-        ++ticks;
-        toggle_caret();
-        char key = kbhandler();
 
-        if (!key) {
-            lastkey = 0;
-            repeating = 0;
-            continue;
+    char key = kbhandler();
+    if (!key) {
+        lastkey = 0;
+        return 0;
+    }
+    if (key != lastkey) {
+        lastkey = key;
+        repeat_delay = 0;
+        if (key == KEY_CAPSLOCK) {
+            capslock = !capslock;
+            return 0;
         }
-        if (key != lastkey) {
-            lastkey = key;
-            repeat_delay = 0;
-            if (key == KEY_CAPSLOCK) {
-                capslock = !capslock;
-                continue;
-            }
-            if (capslock){
-                if (key >= 'a' && key <= 'z') key -= 0x20;
-                else if (key >= 'A' && key <= 'Z') key += 0x20;
-            }
-            return key;
-        } else {
-            ++repeat_delay;
-            if (repeat_delay < REPEAT_DELAY) continue;
-            if (repeat_delay < REPEAT_DELAY+REPEAT_RATE) continue;
-            repeat_delay = REPEAT_DELAY;
-            if (capslock){
-                if (key >= 'a' && key <= 'z') key -= 0x20;
-                else if (key >= 'A' && key <= 'Z') key += 0x20;
-            }
+    } else {
+        if (key == KEY_CAPSLOCK) return 0;
+        ++repeat_delay;
+        if (repeat_delay < REPEAT_DELAY+REPEAT_RATE) return 0;
+        repeat_delay = REPEAT_DELAY;
+    }
+    if (capslock){
+        if (key >= 'a' && key <= 'z') key -= 0x20;
+        else if (key >= 'A' && key <= 'Z') key += 0x20;
+    }
+    return key;
+}
+
+IM2_DEFINE_ISR(kbd_isr) {
+    ++ticks;
+    char key = kbd_repeat();
+    if (key && ((key_head + 1) & KEY_QUEUE_MASK) != key_tail) {
+        key_queue[key_head] = key;
+        key_head = (key_head + 1) & KEY_QUEUE_MASK;
+    }
+}
+
+void kbd_init(void) MYCC {
+    // im2_space ends at 0xffff at the latest, so the table page is at most
+    // 0xfd: I is never 0xff and neither the vectors nor the JP wrap to 0x0000
+    uint8_t *table = (uint8_t*)(((uint16_t)im2_space + 255) & 0xff00);
+    uint8_t vector = ((uint16_t)table >> 8) + 1;
+    uint8_t *jump = (uint8_t*)(((uint16_t)vector << 8) | vector);
+
+    memset(table, vector, 257);
+    jump[0] = 0xc3;     // JP kbd_isr
+    *(uint16_t*)&jump[1] = (uint16_t)kbd_isr;
+
+    intrinsic_di();
+    im2_init(table);
+    intrinsic_ei();
+}
+
+void kbd_shutdown(void) MYCC {
+    intrinsic_di();
+    intrinsic_im_1();
+    intrinsic_ei();
+}
+
+uint8_t kbhit(void) MYCC {
+    return key_head != key_tail;
+}
+
+char getch(void) MYCC {
+#ifdef REPLAY
+    replay_end(); // a key read by edit_line or a prompt is done when the next one is wanted
+#endif
+    screen_flip();
+    position_caret();
+#ifdef REPLAY
+    char next = replay_next();
+    if (next) {
+        replay_begin(next);
+        return next;
+    }
+#endif
+    for(;;) {
+        if (kbhit()) {
+            char key = key_queue[key_tail];
+            key_tail = (key_tail + 1) & KEY_QUEUE_MASK;
+#ifdef REPLAY
+            replay_capture(key);
+#endif
             return key;
         }
+        intrinsic_halt();
+        toggle_caret();
     }  
 }
 
@@ -359,6 +472,30 @@ uint16_t get_ticks(void) MYCC {
     return ticks;
 }
 
+/* Shift the visible part of an edit field to a new offset, returns the new offset */
+static uint8_t edit_scroll(uint8_t ex, uint8_t ey, uint8_t w, const char* buffer, uint8_t offs, uint8_t noffs) {
+    if (noffs > offs) {
+        uint8_t d = noffs - offs;
+        if (d < w) {
+            move_cols(ex, ex + d, w - d, ey, 1);
+        } else {
+            d = w;
+        }
+        set_cursor_pos(ex + w - d, ey);
+        tile_field(d, buffer + noffs + w - d);
+    } else if (noffs < offs) {
+        uint8_t d = offs - noffs;
+        if (d < w) {
+            move_cols(ex + d, ex, w - d, ey, 1);
+        } else {
+            d = w;
+        }
+        set_cursor_pos(ex, ey);
+        tile_field(d, buffer + noffs);
+    }
+    return noffs;
+}
+
 uint8_t edit_line(const char* prompt, const char* alphabet, char* buffer, uint8_t maxlen) MYCC {
     uint8_t ox, oy;
     get_cursor_pos(&ox, &oy);
@@ -367,19 +504,18 @@ uint8_t edit_line(const char* prompt, const char* alphabet, char* buffer, uint8_
     if (prompt) print("%s:", prompt);
     get_cursor_pos(&ex, &ey);
 
+    uint8_t w = SCREEN_WIDTH - ex;  // visible columns, the caret may sit one past the text
     size_t len = strlen(buffer);
     uint8_t i = len;
-    uint8_t redraw = 1;
+    uint8_t offs = i < w ? 0 : i - w + 1;  // first visible character
     uint8_t retval = 255;
 
+    set_cursor_pos(ex, ey);
+    tile_field(w, buffer + offs);
+
     while (retval == 255) {
-        if (redraw) {
-            set_cursor_pos(ex, ey);
-            print(buffer);
-            clreol();
-            redraw = 0;
-        }
-        set_cursor_pos(ex + i, ey);
+        uint8_t from = 255;         // first character to repaint, 255 for none
+        set_cursor_pos(ex + i - offs, ey);
 
         char ch = getch();
         switch (ch) {
@@ -391,8 +527,8 @@ uint8_t edit_line(const char* prompt, const char* alphabet, char* buffer, uint8_
                     --i;
                     memmove(&buffer[i], &buffer[i + 1], len - i);
                     --len;
+                    from = i;
                 }
-                redraw = 1;
                 break;
             case KEY_LEFT:
                 if (i > 0) --i;
@@ -407,14 +543,26 @@ uint8_t edit_line(const char* prompt, const char* alphabet, char* buffer, uint8_
                 if (len < maxlen && ch >= 32 && ch <= 128) {
                     if (!alphabet || strchr(alphabet, ch)) {
                         memmove(buffer + i + 1, buffer + i, len - i);
+                        from = i;
                         buffer[i++] = ch;
                         if (i > len) buffer[i] = '\0';
                         ++len;
-                        redraw = 1;
                     }
                 }
                 break;
         }
+
+        // Keep the caret in view, then repaint only the tail that changed
+        if (i < offs) {
+            offs = edit_scroll(ex, ey, w, buffer, offs, i);
+        } else if (i - offs >= w) {
+            offs = edit_scroll(ex, ey, w, buffer, offs, i - w + 1);
+        }
+        if (from != 255) {
+            if (from < offs) from = offs;
+            set_cursor_pos(ex + from - offs, ey);
+            tile_field(w - (from - offs), buffer + from);
+        }
     }
     set_cursor_pos(ox, oy);
     clreol();
@@ -20,6 +20,8 @@
 #define KEY_PAGEDOWN    182
 #define KEY_PAGEUP      183
 #define KEY_WORDRIGHT   184
+#define KEY_JUMPUP      245 // ^U
+#define KEY_JUMPDOWN    228 // ^D
 
 #define KEY_MARK        237
 #define KEY_PASTE       246
@@ -28,13 +30,22 @@
 #define KEY_QUIT        241
 #define KEY_FIND        230
 #define KEY_SAVE        243
+#define KEY_QUICKSAVE   234 // ^J
+#define KEY_IMPORT      233 // ^I
+#define KEY_EXPORT      229 // ^E
 #define KEY_GOTO        231
 #define KEY_CUTLINE     235 // ^K
+#define KEY_PROFILE     240 // ^P
+#define KEY_BENCH       226 // ^B
 
 #define NL              '\n'
 
 void screen_init(void) MYCC;
 void screen_restore(void) MYCC;
+void screen_flip(void) MYCC;
+#ifdef PROFILE
+void flip_all(uint8_t use_dma) MYCC;
+#endif
 
 void show_caret(void) MYCC;
 void hide_caret(void) MYCC;
@@ -43,12 +54,23 @@ void toggle_caret(void) MYCC;
 void cls(void) MYCC;
 void clreol(void) MYCC;
 
+void move_rows(uint8_t dst, uint8_t src, uint8_t count) MYCC;
+void move_cols(uint8_t dst, uint8_t src, uint8_t width, uint8_t top, uint8_t count) MYCC;
+
 void putch(char ch) MYCC;
 void putch_at(uint8_t x, uint8_t y, char ch) MYCC;
 void print(const char *fmt, ...) MYCC;
 void prints(const char *s) MYCC;
+
+// Fast writers (crtio_s.asm), clipped at the right edge with no wrapping or NL handling
+void tile_puts(const char *s) MYCC;
+void tile_field(uint8_t width, const char *s) MYCC;
 char getch(void) MYCC;
 
+// Keys are scanned by an IM2 interrupt into a type-ahead queue, long
+// running operations can check it without consuming anything
+uint8_t kbhit(void) MYCC;
+
 void set_cursor_pos(uint8_t x, uint8_t y) MYCC;
 void get_cursor_pos(uint8_t *x, uint8_t *y) MYCC;
 
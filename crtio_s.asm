@@ -2,6 +2,19 @@ SECTION code_l
 PUBLIC _setup_caret_sprite
 PUBLIC _kbd_scan
 PUBLIC _kbstate
+PUBLIC _tile_puts
+PUBLIC _tile_field
+PUBLIC _clreol
+PUBLIC _row_addr
+
+EXTERN _cx
+EXTERN _cy
+EXTERN _attr
+EXTERN _tile_back
+EXTERN _dirty_top
+EXTERN _dirty_bottom
+
+defc SCREEN_WIDTH = 80
 
 _setup_caret_sprite:        
         push af
@@ -46,3 +59,186 @@ scan_port:
 
 _kbstate: db 0,0,0,0,0,0,0,0
 
+; Widen the dirty row span to include row a
+mark_row:
+        ld hl, _dirty_top
+        cp (hl)
+        jr nc, mark_row_bottom
+        ld (hl), a
+mark_row_bottom:
+        ld hl, _dirty_bottom
+        cp (hl)
+        ret c
+        ld (hl), a
+        ret
+
+; hl = back buffer address of (_cx, _cy), marking the row dirty
+; b  = columns left on the row, 0 when the caret is past the right edge
+cursor_addr:
+        ld a, (_cy)
+        call mark_row
+        ld a, (_cy)
+        add a, a
+        ld hl, _row_addr
+        add hl, a
+        ld a, (hl)
+        inc hl
+        ld h, (hl)
+        ld l, a
+        ld a, (_cx)
+        ld b, a
+        add a, a
+        add hl, a
+        ld a, SCREEN_WIDTH
+        sub b
+        ld b, a
+        ret nc
+        ld b, 0
+        ret
+
+; void tile_puts(const char *s) __sdcccall(1)
+; hl = string, written at the caret in the current attribute
+; Stops at the right edge, no wrapping or control characters
+_tile_puts:
+        ex de, hl
+        call cursor_addr
+        ld a, b
+        or a
+        ret z
+        ld a, (_attr)
+        ld c, a
+puts_loop:
+        ld a, (de)
+        or a
+        jr z, puts_done
+        cp 32
+        jr c, puts_bad
+        cp 129
+        jr c, puts_ok
+puts_bad:
+        ld a, 128
+puts_ok:
+        sub 32
+        ld (hl), a
+        inc hl
+        ld (hl), c
+        inc hl
+        inc de
+        djnz puts_loop
+puts_done:
+        ld a, SCREEN_WIDTH
+        sub b
+        ld (_cx), a
+        ret
+
+; void tile_field(uint8_t width, const char *s) __sdcccall(1)
+; a = field width, de = string
+; Writes at most width characters of s and pads the rest of the field with blanks
+_tile_field:
+        or a
+        ret z
+        ld c, a
+        call cursor_addr
+        ld a, b
+        or a
+        ret z
+        ld a, c
+        cp b
+        jr c, field_fits
+        ld c, b                     ; clip to the right edge
+field_fits:
+        ld a, (_cx)
+        add a, c
+        ld (_cx), a
+        ld b, c
+        ld a, (_attr)
+        ld c, a
+field_text:
+        ld a, (de)
+        or a
+        jr z, field_pad
+        cp 32
+        jr c, field_bad
+        cp 129
+        jr c, field_ok
+field_bad:
+        ld a, 128
+field_ok:
+        sub 32
+        ld (hl), a
+        inc hl
+        ld (hl), c
+        inc hl
+        inc de
+        djnz field_text
+        ret
+field_pad:
+        ld (hl), 0                  ; ' ' in the current attribute
+        inc hl
+        ld (hl), c
+        dec hl
+        dec b
+        ret z
+        ld a, b
+        jr fill_pairs
+
+; void clreol(void) __sdcccall(1)
+; Clears from the caret to the end of the row
+_clreol:
+        call cursor_addr
+        ld a, b
+        or a
+        ret z
+        ld (hl), 0
+        inc hl
+        ld (hl), 0
+        dec hl
+        dec a
+        ret z
+
+; Replicate the tile/attribute pair at hl over the following a pairs
+fill_pairs:
+        ld d, h
+        ld e, l
+        inc de
+        inc de
+        add a, a
+        ld c, a
+        ld b, 0
+        ldir
+        ret
+
+; Back buffer address of each text row
+_row_addr:
+        defw _tile_back + 0 * SCREEN_WIDTH * 2
+        defw _tile_back + 1 * SCREEN_WIDTH * 2
+        defw _tile_back + 2 * SCREEN_WIDTH * 2
+        defw _tile_back + 3 * SCREEN_WIDTH * 2
+        defw _tile_back + 4 * SCREEN_WIDTH * 2
+        defw _tile_back + 5 * SCREEN_WIDTH * 2
+        defw _tile_back + 6 * SCREEN_WIDTH * 2
+        defw _tile_back + 7 * SCREEN_WIDTH * 2
+        defw _tile_back + 8 * SCREEN_WIDTH * 2
+        defw _tile_back + 9 * SCREEN_WIDTH * 2
+        defw _tile_back + 10 * SCREEN_WIDTH * 2
+        defw _tile_back + 11 * SCREEN_WIDTH * 2
+        defw _tile_back + 12 * SCREEN_WIDTH * 2
+        defw _tile_back + 13 * SCREEN_WIDTH * 2
+        defw _tile_back + 14 * SCREEN_WIDTH * 2
+        defw _tile_back + 15 * SCREEN_WIDTH * 2
+        defw _tile_back + 16 * SCREEN_WIDTH * 2
+        defw _tile_back + 17 * SCREEN_WIDTH * 2
+        defw _tile_back + 18 * SCREEN_WIDTH * 2
+        defw _tile_back + 19 * SCREEN_WIDTH * 2
+        defw _tile_back + 20 * SCREEN_WIDTH * 2
+        defw _tile_back + 21 * SCREEN_WIDTH * 2
+        defw _tile_back + 22 * SCREEN_WIDTH * 2
+        defw _tile_back + 23 * SCREEN_WIDTH * 2
+        defw _tile_back + 24 * SCREEN_WIDTH * 2
+        defw _tile_back + 25 * SCREEN_WIDTH * 2
+        defw _tile_back + 26 * SCREEN_WIDTH * 2
+        defw _tile_back + 27 * SCREEN_WIDTH * 2
+        defw _tile_back + 28 * SCREEN_WIDTH * 2
+        defw _tile_back + 29 * SCREEN_WIDTH * 2
+        defw _tile_back + 30 * SCREEN_WIDTH * 2
+        defw _tile_back + 31 * SCREEN_WIDTH * 2
@@ -0,0 +1,61 @@
+#include <stdint.h>
+
+#include "platform.h"
+#include "dma.h"
+
+#define PORT_A_ADDR     2
+#define BLOCK_LEN       4
+#define PORT_A_CFG      6
+#define PORT_B_CFG      8
+#define PORT_B_ADDR     11
+
+#define WR1_INC         0b01010100  // Port A memory, increment, timing follows
+#define WR1_DEC         0b01000100  // Port A memory, decrement, timing follows
+#define WR1_FIXED       0b01100100  // Port A memory, fixed, timing follows
+#define WR2_INC         0b01010000  // Port B memory, increment, timing follows
+#define WR2_DEC         0b01000000  // Port B memory, decrement, timing follows
+
+extern void dma_send(const uint8_t *prog) MYCC;
+
+uint8_t dma_prog[] = {
+    0x83,                   // WR6 - Disable DMA
+    0b01111101,             // WR0 - A->B, port A address and block length follow
+    0, 0,                   //       Port A address
+    0, 0,                   //       Block length
+    WR1_INC, 0x02,          // WR1 - Port A, cycle length 2
+    WR2_INC, 0x02,          // WR2 - Port B, cycle length 2
+    0b10101101,             // WR4 - Continuous mode, port B address follows
+    0, 0,                   //       Port B address
+    0b10000010,             // WR5 - Stop at end of block
+    0xcf,                   // WR6 - Load
+    0x87,                   // WR6 - Enable DMA
+};
+
+static uint8_t fill_value;
+
+static void dma_run(const void *src, void *dst, uint16_t len, uint8_t wr1, uint8_t wr2) {
+    *(uint16_t*)&dma_prog[PORT_A_ADDR] = (uint16_t)src;
+    *(uint16_t*)&dma_prog[BLOCK_LEN] = len;
+    dma_prog[PORT_A_CFG] = wr1;
+    dma_prog[PORT_B_CFG] = wr2;
+    *(uint16_t*)&dma_prog[PORT_B_ADDR] = (uint16_t)dst;
+    dma_send(dma_prog);
+}
+
+void dma_copy(void *dst, const void *src, uint16_t len) MYCC {
+    if (!len) return;
+    const uint8_t *s = (const uint8_t*)src;
+    uint8_t *d = (uint8_t*)dst;
+    if (d > s && d < s + len) {
+        // Overlapping move up in memory, run it from the end
+        dma_run(s + len - 1, d + len - 1, len, WR1_DEC, WR2_DEC);
+    } else {
+        dma_run(s, d, len, WR1_INC, WR2_INC);
+    }
+}
+
+void dma_fill(void *dst, uint8_t value, uint16_t len) MYCC {
+    if (!len) return;
+    fill_value = value;
+    dma_run(&fill_value, dst, len, WR1_FIXED, WR2_INC);
+}
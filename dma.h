@@ -0,0 +1,11 @@
+#ifndef DMA_H_
+#define DMA_H_
+
+#include <stdint.h>
+
+// Memory to memory transfers on the zxnDMA. The CPU is held until the
+// block is done, so these are drop-in replacements for memmove/memset.
+void dma_copy(void *dst, const void *src, uint16_t len) MYCC;
+void dma_fill(void *dst, uint8_t value, uint16_t len) MYCC;
+
+#endif //DMA_H_
@@ -0,0 +1,12 @@
+SECTION code_l
+PUBLIC _dma_send
+
+defc DMA_PORT = 0x6b
+defc DMA_PROG_LEN = 16
+
+; void dma_send(const uint8_t *prog) __sdcccall(1)
+; hl = DMA program, DMA_PROG_LEN bytes
+_dma_send:
+        ld bc, DMA_PROG_LEN * 256 + DMA_PORT
+        otir
+        ret
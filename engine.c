@@ -0,0 +1,1762 @@
+#ifdef MEMDBG
+#define _CRTDBG_MAP_ALLOC
+#include <stdlib.h>
+#include <crtdbg.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
+
+#include "platform.h"
+#include "profile.h"
+#include "engine.h"
+
+#define MAX_FUNC_ARGS 5
+
+#define MAX_PENDING     64  // cells tracked by a batch before batch_commit scans every cell
+
+#define MAX_JOURNAL     64  // edits held for a quick save before it falls back to a full save
+
+#define MAX_SAVE_COPIES 16  // cells edited ahead of a background save before it completes in the foreground
+
+char* e_filename = NULL;
+uint8_t is_dirty = 0;
+uint8_t batch_depth = 0; // set_cell defers deps and evaluation while non-zero
+
+Value errInvalidArg = { .type = TYPE_ERROR };
+Value errExprInvalid = { .type = TYPE_ERROR };
+Value errExprDivZero = { .type = TYPE_ERROR };
+Value errExprCyclicRef = { .type = TYPE_ERROR };
+Value errExprExpectLParen = { .type = TYPE_ERROR };
+Value errExprExpectRParen = { .type = TYPE_ERROR };
+Value errExprExpectNumeric = { .type = TYPE_ERROR };
+Value errOutOfMemory = { .type = TYPE_ERROR };
+
+/* Error texts, called once at start up */
+void engine_init(void) {
+    errInvalidArg.str = "Invalid argument";
+    errExprInvalid.str = "Invalid expression";
+    errExprDivZero.str = "Division by zero";
+    errExprCyclicRef.str = "Cyclic reference";
+    errExprExpectLParen.str = "Expected '('";
+    errExprExpectRParen.str = "Expected ')'";
+    errExprExpectNumeric.str = "Expected numeric value";
+    errOutOfMemory.str = "Out of memory";
+}
+
+// Error values by index in binary files, append only
+Value* const error_values[] = {
+    &errInvalidArg, &errExprInvalid, &errExprDivZero, &errExprCyclicRef,
+    &errExprExpectLParen, &errExprExpectRParen, &errExprExpectNumeric, &errOutOfMemory
+};
+#define ERROR_VALUE_COUNT (sizeof(error_values) / sizeof(error_values[0]))
+
+Cell* journal[MAX_JOURNAL];     // cells edited since the last save
+uint8_t journal_count = 0;
+uint8_t journal_overflow = 0;
+uint16_t journal_records = 0;   // records in the .jnl file since the last full save
+
+typedef struct {
+    uint8_t col;
+    int row;
+    char* content;      // content when the save started, NULL if empty
+} SaveCopy;
+
+void* save_file = NULL;         // document being saved in the background
+uint8_t save_binary;
+int save_row;                   // next row to write, rows above it are in the file
+int save_rows;                  // rows in use when the save started
+SaveCopy save_copies[MAX_SAVE_COPIES];  // cells edited ahead of save_row since the save started
+uint8_t save_copy_count = 0;
+
+Cell* pending[MAX_PENDING];     // cells set in the open batch
+uint8_t pending_count = 0;
+uint8_t pending_overflow = 0;
+
+uint8_t is_str_value(Value v) {
+    return v.type == TYPE_STR || v.type == TYPE_TEXT;
+}
+
+HNode* hash_table[CELL_TBL_SIZE] = { 0 }; // hash table for cells
+
+void* load_file = NULL;     // document still loading in the background
+uint32_t load_size;
+int load_row;               // row of the last record parsed, -1 before the first
+uint8_t load_sorted;        // the file declared row-major order
+
+int max_cell_key = -1;                      // highest row-major index of any cell created
+uint32_t row_occ[MAX_ROWS] = { 0 };         // bit per column set when the cell has content
+uint8_t col_occ[MAX_COLS][MAX_ROWS / 8];    // the same bits per column, 8 rows to a byte
+
+Cell* find_cell(int col, int row) {
+    int h = (col + (row * 257)) % CELL_TBL_SIZE;
+    HNode* node = hash_table[h];
+    while (node) {
+        if (node->cell->col == col && node->cell->row == row) {
+            return node->cell;
+        }
+        node = node->next;
+    }
+    return NULL; // not found
+}
+
+void add_cell(Cell* cell) {
+    int h = (cell->col + (cell->row * 257)) % CELL_TBL_SIZE;
+    HNode* node = malloc(sizeof(HNode));
+    if (!node) {
+        error(errOutOfMemory.str);
+        return;
+    }
+    node->cell = cell;
+    node->next = hash_table[h];
+    hash_table[h] = node;
+}
+
+typedef void  (*PFN_ACCUM)(void* state, Cell* cell);
+typedef Value(*PFN_EVAL)(void* state);
+
+typedef struct Function {
+    const char* name;
+    PFN_ACCUM pfn_accum;    // function accumulator
+    PFN_EVAL pfn_eval;      // function evaluator
+    TokenType tok_type;     // token type for this function
+    uint8_t min_args;       // minimum number of arguments
+    uint8_t max_args;       // maximum number of arguments
+} Function;
+
+void sum_range(void* state, Cell* cell);
+Value sum_eval(void* state);
+Value avg_eval(void* state);
+void count_range(void* state, Cell* cell);
+Value count_eval(void* state);
+void max_range(void* state, Cell* cell);
+void min_range(void* state, Cell* cell);
+Value best_eval(void* state);
+
+Value sin_eval(void* state);
+Value cos_eval(void* state);
+Value tan_eval(void* state);
+Value asin_eval(void* state);
+Value acos_eval(void* state);
+Value atan_eval(void* state);
+
+Value abs_eval(void* state);
+Value ceil_eval(void* state);
+Value floor_eval(void* state);
+Value round_eval(void* state);
+Value trunc_eval(void* state);
+
+Value sqrt_eval(void* state);
+Value exp_eval(void* state);
+Value log_eval(void* state);
+Value log10_eval(void* state);
+Value log2_eval(void* state);
+
+Value dec2bin_eval(void* state);
+Value bin2dec_eval(void* state);
+Value dec2hex_eval(void* state);
+Value hex2dec_eval(void* state);
+
+Value if_eval(void* state);
+
+Function functions[] = {
+    { "SUM", sum_range, sum_eval, tokRangeFunc, 1, 1},
+    { "AVG", sum_range, avg_eval, tokRangeFunc, 1, 1 },
+    { "COUNT", count_range, count_eval, tokRangeFunc, 1, 1 },
+    { "MAX", max_range, best_eval, tokRangeFunc, 1, 1 },
+    { "MIN", min_range, best_eval, tokRangeFunc, 1, 1 },
+    { "SIN", NULL, sin_eval, tokScalarFunc, 1, 1},
+    { "COS", NULL, cos_eval, tokScalarFunc, 1, 1},
+    { "TAN", NULL, tan_eval, tokScalarFunc, 1, 1},
+    { "ASIN", NULL, asin_eval, tokScalarFunc, 1, 1},
+    { "ACOS", NULL, acos_eval, tokScalarFunc, 1, 1},
+    { "ATAN", NULL, atan_eval, tokScalarFunc, 1, 1},
+    { "ABS", NULL, abs_eval, tokScalarFunc, 1, 1},
+    { "CEIL", NULL, ceil_eval, tokScalarFunc, 1, 1},
+    { "FLOOR", NULL, floor_eval, tokScalarFunc, 1, 1},
+    { "ROUND", NULL, round_eval, tokScalarFunc, 1, 1},
+    { "TRUNC", NULL, trunc_eval, tokScalarFunc, 1, 1},
+    { "SQRT", NULL, sqrt_eval, tokScalarFunc, 1, 1},
+    { "EXP", NULL, exp_eval, tokScalarFunc, 1, 1},
+    { "LOG", NULL, log_eval, tokScalarFunc, 1, 1},
+    { "LOG10", NULL, log10_eval, tokScalarFunc, 1, 1},
+    { "LOG2", NULL, log2_eval, tokScalarFunc, 1, 1},
+    { "DEC2BIN", NULL, dec2bin_eval, tokScalarFunc, 1, 1},
+    { "BIN2DEC", NULL, bin2dec_eval, tokScalarFunc, 1, 1},
+    { "DEC2HEX", NULL, dec2hex_eval, tokScalarFunc, 1, 1},
+    { "HEX2DEC", NULL, hex2dec_eval, tokScalarFunc, 1, 1},
+    { "IF", NULL, if_eval, tokScalarFunc, 3, 3},
+
+    { NULL, NULL }  /* sentinel */
+};
+
+TokenType tok_type;
+char token[32];
+char* expr;
+char ch;
+Function* current_function;
+
+void next_char(void) {
+    ch = *expr;
+    if (ch == 0) return;
+    ++expr;
+}
+
+void parse_cellref(const char** sp, int* col, int* row);
+void parse_range(const char** sp, int* from_col, int* from_row, int* to_col, int* to_row);
+
+uint8_t is_cellref(const char* s) {
+    int n = 0;
+    if (!isalpha(*s)) return 0;
+    ++s;
+    if (!isdigit(*s)) return 0;
+    while (isdigit(*s)) {
+        n = n * 10 + (*s - '0');
+        ++s;
+    }
+    if (n < 1 || n > MAX_ROWS) return 0;
+    return *s == 0;
+}
+
+void get_token(void) {
+    tok_type = tokNone;
+
+    while (isspace(ch)) next_char();
+    if (ch == 0) {
+        tok_type = tokEnd;
+        return;
+    }
+    if (isalpha(ch)) {
+        int i = 0;
+        while (isalpha(ch) || isdigit(ch)) {
+            if (i < sizeof(token) - 1)
+                token[i++] = toupper(ch);
+            next_char();
+        }
+        token[i] = 0;
+        if (is_cellref(token)) {
+            tok_type = tokCellRef;
+            if (ch == ':') {
+                token[i++] = ch; // include ':' in token
+                next_char(); // skip ':'
+                char* s = token + i;
+                while (isalpha(ch) || isdigit(ch)) {
+                    if (i < sizeof(token) - 1)
+                        token[i++] = toupper(ch);
+                    next_char();
+                }
+                token[i] = 0;
+                if (!is_cellref(s)) {
+                    tok_type = tokError;
+                    return;
+                }
+                tok_type = tokRange;
+            }
+        }
+        else {
+            for (Function* f = functions; f->name; f++) {
+                if (strcmp(f->name, token) == 0) {
+                    tok_type = f->tok_type;
+                    current_function = f;
+                    break;
+                }
+            }
+        }
+        if (tok_type == tokNone) tok_type = tokError;
+    }
+    else if (isdigit(ch)) {
+        int i = 0;
+        while (isdigit(ch)) {
+            if (i < sizeof(token) - 1)
+                token[i++] = ch;
+            next_char();
+        }
+        if (ch == '.') {
+            if (i < sizeof(token) - 1)
+                token[i++] = ch;
+            next_char();
+            while (isdigit(ch)) {
+                if (i < sizeof(token) - 1)
+                    token[i++] = ch;
+                next_char();
+            }
+        }
+        token[i] = 0;
+        tok_type = tokNumber;
+    }
+    else {
+        switch (ch) {
+            case '=': tok_type = tokEq; next_char(); break;
+            case '<': 
+            next_char();
+            if (ch == '=') {
+                tok_type = tokLe; next_char();
+            } else if (ch == '>') {
+                tok_type = tokNe; next_char();
+            }
+            else {
+                tok_type = tokLt;
+            }
+            break;
+            case '>':
+                next_char();
+                if (ch == '=') {
+                    tok_type = tokGe; next_char();
+                }
+                else {
+                    tok_type = tokGt;
+                }
+            break;                
+            case '+': tok_type = tokPlus; next_char(); break;
+            case '-': tok_type = tokMinus; next_char(); break;
+            case '*': tok_type = tokMul; next_char(); break;
+            case '/': tok_type = tokDiv; next_char(); break;
+            case '%': tok_type = tokMod; next_char(); break;
+            case '(': tok_type = tokLParen; next_char(); break;
+            case ')': tok_type = tokRParen; next_char(); break;
+            case ',': tok_type = tokComma; next_char(); break;
+            case '\'': // string literal start
+            case '"': 
+                {
+                    char quote = ch;
+                    int i = 0;
+                    next_char();
+                    while (ch && ch != quote) {
+                        if (i < sizeof(token) - 1)
+                            token[i++] = ch;
+                        next_char();
+                    }
+                    if (ch == quote) {
+                        next_char(); // skip closing quote
+                        token[i] = 0;
+                        tok_type = tokString;
+                    }
+                    else {
+                        tok_type = tokError; // unterminated string
+                    }
+                }
+                break;
+            default:
+                tok_type = tokError;
+                break;
+        }
+    }
+}
+
+uint8_t expect_token(TokenType expected) {
+    if (tok_type != expected) {
+        return 0;
+    }
+    get_token();
+    return 1;
+}
+
+char* trim(char* s);
+
+/* Helpers for Value */
+Value make_num(float v) {
+    Value x; x.type = TYPE_NUM; x.num = v; return x;
+}
+
+Value make_str(const char* s) {
+    Value x; x.type = TYPE_STR;
+    if (s) x.str = strdup(s); else x.str = NULL;
+    return x;
+}
+
+void free_val(Value *v) {
+    if (v->type == TYPE_STR && v->str) {
+        free(v->str);        
+    }
+    v->type = TYPE_NULL;
+    v->str = NULL;
+}
+
+// Trim leading/trailing space
+char* trim(char* s) {
+    char* p = s + strlen(s) - 1;
+    while (p >= s && isspace(*p)) *p-- = 0;
+    p = s;
+    while (*p && isspace(*p)) p++;
+    return p;
+}
+
+Cell* new_cell(int c, int r) {
+    Cell* p = calloc(1, sizeof(Cell));
+    if (p == NULL) {
+        error(errOutOfMemory.str);
+        return NULL;
+    }
+    p->col = c; p->row = r;
+    add_cell(p);
+    if (r * MAX_COLS + c > max_cell_key) max_cell_key = r * MAX_COLS + c;
+    return p;
+}
+
+void remove_revdep(Cell* c, Cell* dep) {
+    Dep** pp = &c->revdeps;
+    while (*pp && (*pp)->cell != dep) pp = &(*pp)->next;
+    if (*pp) {
+        Dep* t = *pp; *pp = t->next; // unlink
+        free(t);
+    }
+}
+
+void remove_deps(Cell* c) {
+    Dep* d = c->deps;
+    while (d) {
+        Dep* t = d; d = d->next;
+        remove_revdep(t->cell, c);
+        free(t);
+    }
+    c->deps = NULL;
+}
+
+#if defined(MEMDBG) || defined(HOST) || defined(TICKS)
+void free_deplist(Dep *d) {
+    while (d) {
+        Dep* t = d; d = d->next;
+        free(t);
+    }        
+}
+
+void remove_cell(Cell* cell) {
+    int h = (cell->col + (cell->row * 257)) % CELL_TBL_SIZE;
+    HNode* node = hash_table[h];
+    HNode* prev = NULL;
+
+    free_deplist(cell->deps);
+    free_deplist(cell->revdeps);
+    while (node) {
+        if (node->cell == cell) {
+            if (prev) {
+                prev->next = node->next;
+            }
+            else {
+                hash_table[h] = node->next;
+            }
+            free(node);
+            return;
+        }
+        prev = node;
+        node = node->next;
+    }
+}
+
+void free_cell(Cell* c) {
+    if (c->content) free(c->content);
+    if (c->disp) free(c->disp);
+    free_val(&c->cached);
+    remove_cell(c);
+    free(c);
+}
+
+void free_cells(void) {
+    for (int i = 0; i < CELL_TBL_SIZE; i++) {
+        HNode* node = hash_table[i];
+        while (node) {
+            HNode* next = node->next;
+            Cell* c = node->cell;
+            free_cell(c);            
+            node = next;
+        }
+        hash_table[i] = NULL; // clear the hash table entry
+    }
+    memset(row_occ, 0, sizeof(row_occ));
+    memset(col_occ, 0, sizeof(col_occ));
+    max_cell_key = -1;
+}
+#endif //MEMDBG || HOST || TICKS
+
+/* Add owner→dependency link both ways */
+void add_dep(Cell* owner, Cell* dep) {
+    Dep* d = malloc(sizeof * d);
+    if (d == NULL) {
+        error(errOutOfMemory.str);
+        return;
+    }
+    d->cell = dep; d->next = owner->deps; owner->deps = d;
+    Dep* r = malloc(sizeof * r);
+    if (d == NULL) {
+        error(errOutOfMemory.str);
+        return;
+    }
+    r->cell = owner; r->next = dep->revdeps; dep->revdeps = r;
+}
+
+/* Mark c and all its dependents dirty, and for recalc to visit */
+void propagate_dirty(Cell* c) {
+    if (!(c->flags & FLG_RECALC)) {
+        c->flags |= FLG_DIRTY | FLG_RECALC;
+        for (Dep* d = c->revdeps; d; d = d->next)
+            propagate_dirty(d->cell);
+    }
+}
+
+/*
+Evaluate every cell propagate_dirty marked from c. eval_cell evaluates
+dependencies first, so the order of the walk does not matter, and cells it
+already evaluated are still walked through to reach their own dependents.
+*/
+void recalc(Cell* c) {
+    if (!(c->flags & FLG_RECALC)) return;
+    c->flags &= MSK_RECALC;
+    eval_cell(c);
+    for (Dep* d = c->revdeps; d; d = d->next)
+        recalc(d->cell);
+}
+
+/* Evaluate a cell (with caching & cycle detect) */
+void eval_cell(Cell* c);
+Value eval_expr(void);
+Value eval_expr1(void);
+Value eval_term(void);
+Value eval_factor(void);
+
+void parse_cellref(const char** sp, int* col, int* row) {
+    char ref[8] = { 0 };
+    int i = 0;
+    if (isalpha(**sp)) {
+        ref[i++] = toupper(*(*sp)++);
+        while (isdigit(**sp) && i < 7) ref[i++] = *(*sp)++;
+    }
+    ref[i] = 0;
+    *col = ref[0] - 'A';
+    *row = atoi(ref + 1) - 1;
+}
+
+void parse_range(const char** sp, int* from_col, int* from_row, int* to_col, int* to_row) {
+    int c1, r1, c2, r2;
+    parse_cellref(sp, &c1, &r1);
+    if (**sp == ':') (*sp)++;
+    parse_cellref(sp, &c2, &r2);
+    if (c2 < c1) { int t = c1; c1 = c2; c2 = t; }
+    if (r2 < r1) { int t = r1; r1 = r2; r2 = t; }
+    *from_col = c1; *from_row = r1;
+    *to_col = c2; *to_row = r2;
+}
+
+typedef struct {
+    float total;
+    float best;
+    int count;
+} AccumState;
+
+void sum_range(void* state, Cell* cell) {
+    AccumState* acc = (AccumState*)state;
+
+    Value dv = cell->cached;
+    if (dv.type == TYPE_NUM) {
+        acc->total += dv.num;
+        acc->count++;
+    }
+}
+
+Value sum_eval(void* state) {
+    AccumState* acc = (AccumState*)state;
+    Value v = make_num(acc->total);
+    return v;
+}
+
+Value avg_eval(void* state) {
+    AccumState* acc = (AccumState*)state;
+    Value v = make_num(acc->count ? acc->total / acc->count : 0);
+    return v;
+}
+
+void count_range(void* state, Cell* cell) {
+    AccumState* acc = (AccumState*)state;
+    Value v = cell->cached;
+    if (v.type == TYPE_NULL || v.type == TYPE_ERROR) {
+        return; // skip null or error values
+    }
+    if (v.type == TYPE_NUM || (v.str && *v.str)) {
+        acc->count++;
+    }
+}
+
+Value count_eval(void* state) {
+    AccumState* acc = (AccumState*)state;
+    Value v = make_num((float)acc->count);
+    return v;
+}
+
+void max_range(void* state, Cell* cell) {
+    AccumState* acc = (AccumState*)state;
+    Value v = cell->cached;
+    if (v.type == TYPE_NUM) {
+        if (acc->count == 0 || v.num > acc->best) {
+            acc->best = v.num;
+        }
+        acc->count++;
+    }
+}
+
+void min_range(void* state, Cell* cell) {
+    AccumState* acc = (AccumState*)state;
+    Value v = cell->cached;
+    if (v.type == TYPE_NUM) {
+        if (acc->count == 0 || v.num < acc->best) {
+            acc->best = v.num;
+        }
+        acc->count++;
+    }
+}
+
+Value best_eval(void* state) {
+    AccumState* acc = (AccumState*)state;
+    Value v = make_num(acc->best);
+    return v;
+}
+
+Value sin_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(sinf(arg.num));
+    return v;
+}
+
+Value cos_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(cosf(arg.num));
+    return v;
+}
+Value tan_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(tanf(arg.num));
+    return v;
+}
+Value asin_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(asinf(arg.num));
+    return v;
+}
+Value acos_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(acosf(arg.num));
+    return v;
+}
+Value atan_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(atanf(arg.num));
+    return v;
+}
+
+Value abs_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(fabsf(arg.num));
+    return v;
+}
+Value ceil_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(ceilf(arg.num));
+    return v;
+}
+Value floor_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(floorf(arg.num));
+    return v;
+}
+Value round_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num((float)(int)(arg.num + 0.5));
+    return v;
+}
+Value trunc_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(truncf(arg.num));
+    return v;
+}
+
+Value sqrt_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(sqrtf(arg.num));
+    return v;
+}
+Value exp_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(expf(arg.num));
+    return v;
+}
+Value log_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(logf(arg.num));
+    return v;
+}
+Value log10_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(log10f(arg.num));
+    return v;
+}
+Value log2_eval(void* state) {
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    Value v = make_num(log2f(arg.num));
+    return v;
+}
+
+Value dec2bin_eval(void* state) {
+    char b[32];
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    int n = (int)arg.num;
+    itoa(n, b, 2);
+    Value v = make_str(b);
+    return v;
+}
+
+Value bin2dec_eval(void* state) {
+    Value arg = *(Value*)state;
+    char* endptr;
+    if (!is_str_value(arg)) return errInvalidArg;
+    int n = (int)strtol(arg.str, &endptr, 2);
+
+    if (*endptr != '\0') return errExprInvalid;
+
+    Value v = make_num((float)n);
+    return v;
+}
+
+Value dec2hex_eval(void* state) {
+    char b[32];
+    Value arg = *(Value*)state;
+    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
+    int n = (int)arg.num;
+    itoa(n, b, 16);
+    Value v = make_str(b);
+    return v;
+}
+
+Value hex2dec_eval(void* state) {
+    Value arg = *(Value*)state;
+    char* endptr;
+    if (is_str_value(arg)) return errInvalidArg;
+    int n = (int)strtol(arg.str, &endptr, 16);
+
+    if (*endptr != '\0') return errExprInvalid;
+
+    Value v = make_num((float)n);
+    return v;
+}
+
+Value if_eval(void* state) {
+    Value* args = (Value*)state;
+    if (args[0].type != TYPE_NUM) {
+        return errExprExpectNumeric;
+    }
+    Value v = args[args[0].num ? 1 : 2]; // return true or false branch
+    return v;
+}
+    
+
+void set_range_dep(void* state, Cell* cell) {
+    Cell* root = (Cell*)state;
+    if (cell->flags & FLG_EMPTY) {
+        cell = new_cell(cell->col, cell->row);
+    }
+    add_dep(root, cell);
+}
+
+Value process_range(
+    int c1, int r1, int c2, int r2,
+    void* state,
+    PFN_ACCUM pfnAccum,
+    PFN_EVAL pfnEval) {
+
+    Cell empty = { 0 };
+    empty.flags |= FLG_EMPTY;
+
+    for (int cc = c1; cc <= c2; cc++) {
+        for (int rr = r1; rr <= r2; rr++) {
+            Cell* cell = find_cell(cc, rr);
+            if (!cell) {
+                cell = &empty;  /* use empty cell if not found */
+                empty.col = cc;
+                empty.row = rr;
+            }
+            pfnAccum(state, cell);
+        }
+    }
+    Value x;
+    if (pfnEval) {
+        x = pfnEval(state);
+    }
+    else {
+        x = make_num(0);  /* default to zero if no final fn */
+    }
+    return x;
+}
+
+/* Rebuild the dependency lists of p from its formula */
+void build_deps(Cell* p) {
+    PROF_BEGIN(PROF_PARSE);
+    remove_deps(p);
+    if (p->flags & FLG_FORMULA) {
+        expr = p->content + 1;
+        next_char();
+        get_token();
+        while (tok_type != tokEnd && tok_type != tokError) {
+            const char* ref = &token[0];
+
+            if (tok_type == tokCellRef) {
+                /* single cell reference */
+                int cc, rr;
+                parse_cellref(&ref, &cc, &rr);
+                Cell* d = find_cell(cc, rr);
+                if (!d) d = new_cell(cc, rr);
+                add_dep(p, d);
+            }
+            else if (tok_type == tokRange) {
+                /* range reference */
+                int c1, r1, c2, r2;
+                parse_range(&ref, &c1, &r1, &c2, &r2);
+                Value v = process_range(
+                    c1, r1, c2, r2,
+                    p,
+                    set_range_dep,
+                    NULL);
+                free_val(&v);
+            }
+            get_token();
+        }
+    }
+    PROF_END(PROF_PARSE);
+}
+
+/* Keep the row and column occupancy bits of a cell in step with its content */
+void set_occ(uint8_t col, uint8_t row, uint8_t used) MYCC {
+    uint8_t* byte = &col_occ[col][row >> 3];
+    uint8_t bit = 1 << (row & 7);
+    if (used) {
+        row_occ[row] |= 1UL << col;
+        *byte |= bit;
+    }
+    else {
+        row_occ[row] &= ~(1UL << col);
+        *byte &= ~bit;
+    }
+}
+
+void update_cell(Cell* p, const char* s);
+
+void set_cell(int c, int r, const char* s) {
+    Cell* p = find_cell(c, r);
+    if (!p && (!s || !*s)) return; // no cell, no text -> nothing to do
+
+    if (!p) {
+        p = new_cell(c, r);
+        if (!p) {
+            error(errOutOfMemory.str);
+            return;
+        }
+    }
+    update_cell(p, s);
+}
+
+/* Set the content of an existing cell */
+void update_cell(Cell* p, const char* s) {
+    if (p->content) {
+        if (s && strcmp(p->content, s) == 0) return; // No change -> nothing to do
+        free(p->content);
+    }
+    
+    char* txt = (char*)s;
+    if (txt) txt = trim(txt);
+    if (!txt || !*txt) {
+        free_val(&p->cached);
+        p->content = NULL;
+        p->flags &= MSK_DIRTY & MSK_FORMULA & MSK_EMPTY; // keep list membership
+        
+        remove_deps(p);
+        goto reevaluate;
+    }
+
+    /* detect formula vs numeric vs string */
+    if (*txt == '=') {
+        p->flags |= FLG_FORMULA;
+        p->content = strdup(txt);
+    }
+    else if (*txt =='\'') {
+        /* string literal */
+        p->flags &= MSK_FORMULA; // clear formula flag
+        p->content = strdup(txt);
+        if (p->content == NULL) {
+            error(errOutOfMemory.str);
+            return;
+        }
+    }
+    else {
+        char* end;
+        float v = strtof(txt, &end);
+        if (end > txt && *end == 0) {
+            /* pure number → treat as single-term formula */
+            p->flags |= FLG_FORMULA;
+            p->content = malloc(strlen(txt) + 2);
+            if (!p->content) {
+                error(errOutOfMemory.str);
+                return;
+            }
+            sprintf(p->content, "=%s", txt);
+        }
+        else {
+            /* string */
+            p->flags &= MSK_FORMULA;
+            p->content = strdup(txt);
+            if (p->content == NULL) {
+                error(errOutOfMemory.str);
+                return;
+            }            
+        }
+    }
+    if (!batch_depth) build_deps(p);
+
+reevaluate:
+    set_occ(p->col, p->row, p->content != NULL);
+    is_dirty = 1; // mark spreadsheet dirty
+    if (batch_depth) {
+        if (!(p->flags & FLG_PENDING)) {
+            if (pending_count < MAX_PENDING) pending[pending_count++] = p;
+            else pending_overflow = 1;
+            p->flags |= FLG_PENDING;
+        }
+        return;
+    }
+    PROF_BEGIN(PROF_EVAL);
+    propagate_dirty(p);
+    recalc(p);
+    PROF_END(PROF_EVAL);
+}
+
+/* Start a bulk update, set_cell only stores content until batch_commit */
+void batch_begin(void) {
+    ++batch_depth;
+}
+
+/* End a bulk update, building the deps of every pending cell and recalculating once */
+void batch_commit(void) {
+    if (!batch_depth || --batch_depth) return;
+
+    if (!pending_overflow) {
+        uint8_t i;
+        for (i = 0; i < pending_count; ++i) build_deps(pending[i]);
+        PROF_BEGIN(PROF_EVAL);
+        for (i = 0; i < pending_count; ++i) {
+            pending[i]->flags &= MSK_PENDING;
+            propagate_dirty(pending[i]);
+        }
+        for (i = 0; i < pending_count; ++i) recalc(pending[i]);
+        PROF_END(PROF_EVAL);
+        pending_count = 0;
+        return;
+    }
+
+    for (int i = 0; i < CELL_TBL_SIZE; i++) {
+        for (HNode* node = hash_table[i]; node; node = node->next) {
+            if (node->cell->flags & FLG_PENDING) build_deps(node->cell);
+        }
+    }
+
+    PROF_BEGIN(PROF_EVAL);
+    for (int i = 0; i < CELL_TBL_SIZE; i++) {
+        for (HNode* node = hash_table[i]; node; node = node->next) {
+            Cell* c = node->cell;
+            if (c->flags & FLG_PENDING) {
+                c->flags &= MSK_PENDING;
+                propagate_dirty(c);
+            }
+        }
+    }
+    for (int i = 0; i < CELL_TBL_SIZE; i++) {
+        for (HNode* node = hash_table[i]; node; node = node->next) {
+            recalc(node->cell);
+        }
+    }
+    PROF_END(PROF_EVAL);
+    pending_count = 0;
+    pending_overflow = 0;
+}
+
+Value parse_expr(char* e) {
+    expr = e;
+    next_char();
+    get_token();
+    Value v;
+    v = eval_expr();    
+    return v;
+}
+
+/* Grammar: expr = expr {relop expr} */
+Value eval_expr(void) {
+    Value v = eval_expr1();
+    if (v.type == TYPE_ERROR) return v; // propagate error
+    Value res = v;
+    while (tok_type == tokEq || tok_type == tokNe || tok_type == tokLt || tok_type == tokLe || tok_type == tokGt || tok_type == tokGe) {
+        TokenType op = tok_type;
+        get_token();  // skip operator
+        Value v2 = eval_expr1();
+
+        if (v2.type == TYPE_ERROR) return v2; // propagate error
+
+        if (v.type == TYPE_NULL && v2.type == TYPE_NULL) {
+            res = make_num(1); // nulls are equal            
+        }
+        else {
+            int cmp = 0;
+            if (is_str_value(v) && is_str_value(v2)) {
+                cmp = strcmp(v.str, v2.str);
+            }
+            else {
+                float n1 = (v.type == TYPE_NUM ? v.num : v.str ? strtof(v.str, NULL) : 0);
+                float n2 = (v2.type == TYPE_NUM ? v2.num : v2.str ? strtof(v2.str, NULL) : 0);
+                cmp = (n1 < n2 ? -1 : (n1 > n2 ? 1 : 0));
+            }
+            switch (op) {
+                case tokEq:
+                    res = make_num((float)(cmp == 0));
+                    break;
+                case tokNe:
+                    res = make_num((float)(cmp != 0));
+                    break;
+                case tokLt:
+                    res = make_num((float)(cmp < 0));
+                    break;
+                case tokLe:
+                    res = make_num((float)(cmp <= 0));
+                    break;
+                case tokGt:
+                    res = make_num((float)(cmp > 0));
+                    break;
+                case tokGe:
+                    res = make_num((float)(cmp >= 0));
+                    break;
+            }
+        }
+        free_val(&v); free_val(&v2);
+        v = res;  // continue with the result
+    }
+    return res;
+}
+
+/* Grammar: expr = term {(+|-) term} */
+Value eval_expr1(void) {
+    Value v = eval_term();
+    if (v.type == TYPE_ERROR) return v; // propagate error
+    Value res = v;
+    while (tok_type == tokPlus || tok_type == tokMinus) {
+        TokenType op = tok_type;
+        get_token();  // skip operator
+        Value v2 = eval_term();
+        if (v2.type == TYPE_ERROR) return v2; // propagate error
+        if (op == tokPlus && (is_str_value(v) || is_str_value(v2))) {
+            char buf[CELL_W] = { 0 }, tmp1[CELL_W] = { 0 }, tmp2[CELL_W] = { 0 };
+            
+            if (is_str_value(v)) {
+                if (v.str) strncpy(tmp1, v.str, CELL_W);
+            }
+            else sprintf(tmp1, "%g", v.num);
+
+            if (is_str_value(v2)) {
+                if (v2.str) strncpy(tmp2, v2.str, CELL_W);
+            }
+            else sprintf(tmp2, "%g", v2.num);
+
+            snprintf(buf, sizeof(buf), "%s%s", tmp1, tmp2);
+            res = make_str(buf);
+        }
+        else {
+            float n1 = (v.type == TYPE_NUM ? v.num : v.str ? strtof(v.str, NULL) : 0);
+            float n2 = (v2.type == TYPE_NUM ? v2.num : v2.str ? strtof(v2.str, NULL) : 0);
+            switch (op) {
+                case tokPlus:
+                    res = make_num(n1 + n2);
+                    break;
+                case tokMinus:
+                    res = make_num(n1 - n2);
+                    break;
+            }
+        }
+        free_val(&v); free_val(&v2);
+        v = res;  // continue with the result
+    }
+    return res;
+}
+
+/* term = factor {(*|/) factor} */
+Value eval_term(void) {
+    Value v = eval_factor();
+    if (v.type == TYPE_ERROR) return v; // propagate error
+    Value res = v;
+    while (tok_type == tokMul || tok_type == tokDiv || tok_type == tokMod) {
+        TokenType op = tok_type;
+        get_token();  // skip operator
+        Value v2 = eval_factor();
+        if (v2.type == TYPE_ERROR) return v2; // propagate error
+        float n1 = (v.type == TYPE_NUM ? v.num : v.str ? strtof(v.str, NULL) : 0);
+        float n2 = (v2.type == TYPE_NUM ? v2.num : v2.str ? strtof(v2.str, NULL) : 0);
+        switch (op) {
+            case tokMul:
+                res = make_num(n1 * n2);
+                break;
+            case tokDiv:
+                if (n2 == 0)
+                    res = errExprDivZero;
+                else
+                    res = make_num(n1 / n2);
+                break;
+            case tokMod:
+                if (n2 == 0)
+                    res = errExprDivZero;
+                else
+                    res = make_num(fmodf(n1, n2));
+                break;
+        }
+        free_val(&v); free_val(&v2);
+        v = res;  // continue with the result
+    }
+    return res;
+}
+
+/* factor = num | ref | AVG(range) | '('expr')' */
+Value eval_factor(void) {
+    Value v = { 0 };
+    uint8_t negative = 0;
+    while (tok_type == tokMinus || tok_type == tokPlus) {
+        if (tok_type == tokMinus) {
+            negative = !negative;  // toggle sign
+        }
+        get_token();  // skip sign
+    }
+
+    switch (tok_type) {
+        case tokError:
+            v = errExprInvalid;
+            break;
+        case tokLParen: {
+            get_token();  // skip '('
+            v = eval_expr();
+            if (v.type == TYPE_ERROR) break;
+
+            if (!expect_token(tokRParen)) {
+                v = errExprExpectRParen;
+                break;
+            }
+        }
+                      break;
+
+        case tokNumber: {
+            float num = strtof(token, NULL);
+            get_token();  // skip number
+            v = make_num(num);
+        }
+                      break;
+
+        case tokCellRef: {
+            int cc, rr;
+            const char* ref = &token[0];
+            parse_cellref(&ref, &cc, &rr);
+            Cell* c = find_cell(cc, rr);
+            if (c) v = c->cached;
+            get_token();  // skip cell reference            
+        }
+                       break;
+
+        case tokRangeFunc: {
+            get_token();
+
+            if (!expect_token(tokLParen)) {
+                v = errExprExpectLParen;
+                break;
+            }
+
+            int c1, r1, c2, r2;
+            char* ref = &token[0];
+            parse_range(&ref, &c1, &r1, &c2, &r2);            
+            get_token();  // skip range
+
+            if (!expect_token(tokRParen)) {
+                v = errExprExpectRParen;
+                break;
+            }
+
+            AccumState acc = { .total = 0, .count = 0 };
+            v = process_range(c1, r1, c2, r2, &acc, current_function->pfn_accum, current_function->pfn_eval);
+        }
+                         break;
+
+        case tokScalarFunc: {
+            get_token();  // skip function name
+            Function* local_function = current_function;
+
+            if (!expect_token(tokLParen)) {
+                v = errExprExpectLParen;
+                break;
+            }
+
+            Value args[MAX_FUNC_ARGS];
+            memset(args, 0, sizeof(args));
+
+            int arg_count = 0;
+            while (arg_count < MAX_FUNC_ARGS) {
+                Value arg = eval_expr();
+                if (arg.type == TYPE_ERROR) {
+                    v = arg;  // error to propagate
+                    break;
+                }
+                args[arg_count++] = arg;
+
+                if (tok_type != tokComma) break;
+                get_token(); // skip comma                
+            }
+
+            if (arg_count < local_function->min_args || arg_count > local_function->max_args) {
+                v = errInvalidArg; // invalid number of arguments
+                break;
+            }
+
+
+            if (v.type == TYPE_ERROR) {
+                break; // propagate error
+            }
+
+            v = local_function->pfn_eval(args);
+
+            if (!expect_token(tokRParen)) {
+                v = v = errExprExpectRParen;
+                break;
+            }
+        } 
+        break;
+        
+        case tokString:
+            v = make_str(token);
+            if (v.str == NULL) {
+                v = errOutOfMemory; // handle memory allocation failure
+            }
+            get_token();  // skip string
+        break;
+
+        default:
+            v = errExprInvalid; // unexpected token
+            break;
+    }
+
+    if (negative) {
+        if (v.type == TYPE_NUM) {
+            v.num = -v.num;
+        }
+    }
+    return v;
+}
+
+// Evaluate cell after its dirty dependencies, caching the result
+void eval_cell(Cell* c) {
+    if (!c) {
+        return;
+    }
+
+    if (!(c->flags & FLG_DIRTY)) {
+        return;
+    }
+
+    free_val(&c->cached);
+    if (!(c->flags & FLG_FORMULA)) {
+        if (c->content) {
+            c->cached.type = TYPE_TEXT;
+            if (*c->content == '\'')
+                c->cached.str = c->content + 1; // skip leading quote
+            else                            
+                c->cached.str = c->content;
+        }
+        else {
+            c->cached.type = TYPE_NULL;
+        }
+    }
+    else if (c->flags & FLG_VISITING) {
+        c->cached = errExprCyclicRef;
+    }
+    else {
+        c->flags |= FLG_VISITING;
+        if (c->deps) {
+            // ensure all dependencies are evaluated
+            for (Dep* d = c->deps; d; d = d->next) {                
+                eval_cell(d->cell);
+            }
+        }
+
+        if (c->flags & FLG_DIRTY) {
+            Value v = parse_expr(c->content + 1);
+
+            c->cached.type = v.type;
+          
+            if (v.type == TYPE_STR) { // DO NOT USE is_str_value, it checks for TYPE_TEXT
+                c->cached.str = v.str ? strdup(v.str) : NULL;
+            }
+            else {
+                c->cached = v; // propagate non-allocated value
+            }
+        }
+        c->flags &= MSK_VISITING; // reset visiting flag
+    }
+    c->flags &= (MSK_DIRTY & MSK_VISITING);
+    if (c->disp) *c->disp = 0; // display text is stale
+    mark_changed(c);
+}
+
+/* Emit "A1:content" */
+void out_text_record(uint8_t col, int row, const char* content) MYCC {
+    char ref[5];
+    char* p = ref;
+    int n = row + 1;
+    *p++ = 'A' + col;
+    if (n >= 100) *p++ = '0' + n / 100;
+    if (n >= 10) *p++ = '0' + n / 10 % 10;
+    *p++ = '0' + n % 10;
+    *p++ = ':';
+    out_write(ref, p - ref);
+    if (content) out_write(content, strlen(content));
+    out_write("\r\n", 2);
+}
+
+void out_record(Cell* c) MYCC {
+    out_text_record(c->col, c->row, c->content);
+}
+
+/* Queue an edited cell for the next quick save */
+void journal_note(Cell* c) MYCC {
+    if (!c || (c->flags & FLG_JOURNAL)) return;
+    if (journal_count == MAX_JOURNAL) {
+        journal_overflow = 1;
+        return;
+    }
+    c->flags |= FLG_JOURNAL;
+    journal[journal_count++] = c;
+}
+
+void journal_name(const char* name) MYCC {
+    strcpy(tmpbuffer, name);
+    strcat(tmpbuffer, ".jnl");
+}
+
+void journal_reset(void) MYCC {
+    for (uint8_t i = 0; i < journal_count; ++i) journal[i]->flags &= MSK_JOURNAL;
+    journal_count = 0;
+    journal_overflow = 0;
+}
+
+/* Append the queued edits to the journal, the cost depends only on the number of edits */
+int journal_save(void) MYCC {
+    journal_name(e_filename);
+    void* f = append_file(tmpbuffer);
+    if (errno) return errno;
+
+    out_open(f);
+    for (uint8_t i = 0; i < journal_count; ++i) out_record(journal[i]);
+    out_flush();
+    close_file(f);
+    if (errno) return errno;
+
+    journal_records += journal_count;
+    journal_reset();
+    return 0;
+}
+
+/*
+Binary format (.zsb), little endian:
+    "ZSB" version
+    per cell with content:
+        col row flags len16 content[len]
+        type [num32 | len16 str[len] | error8]
+        ndeps16 (col row)[ndeps]
+    0xff
+Formulas are stored as text, the evaluator has no compiled form, but
+the cached value and dependency lists are restored without evaluating.
+*/
+#define ZSC_SORTED  "#ZSC sorted"     // text header, cells follow in row-major order
+#define ZSB_MAGIC   "ZSB"
+#define ZSB_VERSION 1
+#define ZSB_END     0xff
+
+uint8_t is_binary_file(const char* name) MYCC {
+    size_t len = strlen(name);
+    if (len < 4) return 0;
+    name += len - 4;
+    return name[0] == '.' && tolower(name[1]) == 'z' && tolower(name[2]) == 's' && tolower(name[3]) == 'b';
+}
+
+void out_u16(uint16_t v) MYCC {
+    out_putc(v & 0xff);
+    out_putc(v >> 8);
+}
+
+void out_binary_record(Cell* c) MYCC {
+    uint16_t len = strlen(c->content);
+    out_putc(c->col);
+    out_putc(c->row);
+    out_putc(c->flags & FLG_FORMULA);
+    out_u16(len);
+    out_write(c->content, len);
+
+    Value* v = &c->cached;
+    // a formula's text result points into the cell it came from, store a copy
+    uint8_t type = v->type == TYPE_TEXT && (c->flags & FLG_FORMULA) ? TYPE_STR : v->type;
+    out_putc(type);
+    if (type == TYPE_NUM) {
+        out_write((const char*)&v->num, sizeof(v->num));
+    } else if (type == TYPE_STR) {
+        len = v->str ? strlen(v->str) : 0;
+        out_u16(len);
+        out_write(v->str, len);
+    } else if (v->type == TYPE_ERROR) {
+        uint8_t i = 0;
+        while (i < ERROR_VALUE_COUNT && error_values[i]->str != v->str) ++i;
+        out_putc(i);
+    }
+
+    len = 0;
+    for (Dep* d = c->deps; d; d = d->next) ++len;
+    out_u16(len);
+    for (Dep* d = c->deps; d; d = d->next) {
+        out_putc(d->cell->col);
+        out_putc(d->cell->row);
+    }
+}
+
+/* Create the .tmp file and write the header, the cells follow through save_step */
+int save_begin(void) MYCC {
+    strcpy(tmpbuffer, e_filename);
+    strcat(tmpbuffer, ".tmp");
+
+    errno = 0;
+    void* f = create_file(tmpbuffer);
+    if (errno) return errno;
+
+    save_binary = is_binary_file(e_filename);
+    out_open(f);
+    if (save_binary) {
+        out_write(ZSB_MAGIC, 3);
+        out_putc(ZSB_VERSION);
+    }
+    else {
+        out_write(ZSC_SORTED "\r\n", sizeof(ZSC_SORTED) + 1);
+    }
+    save_rows = 0;
+    for (int r = 0; r < MAX_ROWS; r++) {
+        if (row_occ[r]) save_rows = r + 1;
+    }
+    save_row = 0;
+    save_file = f;
+    journal_reset(); // later edits belong to the next journal
+    return 0;
+}
+
+SaveCopy* save_copy_find(uint8_t col, int row) MYCC {
+    for (uint8_t i = 0; i < save_copy_count; ++i) {
+        if (save_copies[i].col == col && save_copies[i].row == row) return &save_copies[i];
+    }
+    return NULL;
+}
+
+/* Write whole rows until at least limit records are out, returns 1 when done or on error */
+uint8_t save_step(uint16_t limit) MYCC {
+    uint16_t written = 0;
+    // Row-major order keeps files stable between saves
+    while (save_row < save_rows && written < limit) {
+        int r = save_row++;
+        uint32_t copied = 0;
+        for (uint8_t i = 0; i < save_copy_count; ++i) {
+            if (save_copies[i].row == r) copied |= 1UL << save_copies[i].col;
+        }
+        uint32_t bits = row_occ[r] | copied;
+        for (uint8_t col = 0; bits; col++, bits >>= 1) {
+            if (!(bits & 1)) continue;
+            if ((copied >> col) & 1) {
+                // only text saves run in the background, do_save writes a
+                // binary file in one go before any edit can need a copy
+                const char* content = save_copy_find(col, r)->content;
+                if (!content) continue;
+                out_text_record(col, r, content);
+            }
+            else {
+                Cell* c = find_cell(col, r);
+                if (!c || !c->content || !*c->content) continue;
+                if (save_binary) out_binary_record(c);
+                else out_record(c);
+            }
+            ++written;
+        }
+        if (errno) return 1;
+    }
+    return save_row >= save_rows;
+}
+
+/* Close the .tmp file and swap it in, returns errno */
+int save_end(void) MYCC {
+    if (!errno) {
+        if (save_binary) out_putc(ZSB_END);
+        out_flush();
+    }
+    int err = errno;
+    close_file(save_file);
+    save_file = NULL;
+    for (uint8_t i = 0; i < save_copy_count; ++i) free(save_copies[i].content);
+    save_copy_count = 0;
+
+    if (!err) {
+        strcpy(tmpbuffer, e_filename);
+        strcat(tmpbuffer, ".tmp");
+        rename_file(tmpbuffer, filename);
+        err = errno;
+    }
+    if (err) {
+        journal_overflow = 1; // edits before the save are no longer queued, make the next quick save a full save
+        return errno = err;
+    }
+
+    // the main file now holds every edit
+    journal_name(e_filename);
+    delete_file(tmpbuffer);
+    journal_records = 0;
+    return errno = 0;
+}
+
+int do_save(void) MYCC {
+    status("Saving...");
+    int err = save_begin();
+    if (err) return err;
+    while (!save_step(UINT16_MAX));
+    return save_end();
+}
+
+uint8_t in_u16(uint16_t* v) MYCC {
+    uint8_t b[2];
+    if (in_read((char*)b, 2) != 2) return 0;
+    *v = b[0] | (b[1] << 8);
+    return 1;
+}
+
+Cell* in_cell_ref(void) MYCC {
+    uint8_t b[2];
+    if (in_read((char*)b, 2) != 2 || b[0] >= MAX_COLS || b[1] >= MAX_ROWS) return NULL;
+    Cell* c = find_cell(b[0], b[1]);
+    return c ? c : new_cell(b[0], b[1]);
+}
+
+/* Evaluate the cells a binary load left dirty, and their dependents */
+void load_recalc(void) MYCC {
+    for (int i = 0; i < CELL_TBL_SIZE; i++) {
+        for (HNode* node = hash_table[i]; node; node = node->next) {
+            if (node->cell->flags & FLG_DIRTY) propagate_dirty(node->cell);
+        }
+    }
+    for (int i = 0; i < CELL_TBL_SIZE; i++) {
+        for (HNode* node = hash_table[i]; node; node = node->next) recalc(node->cell);
+    }
+}
+
+/* Stream binary records straight into the cells, returns 0 if the file is damaged */
+uint8_t load_binary(void) MYCC {
+    uint8_t b[3];
+    uint16_t len;
+    uint8_t stale = 0;  // formulas saved without their text result, by earlier versions
+    for (;;) {
+        if (in_read((char*)b, 1) != 1) return 0;
+        if (b[0] == ZSB_END) {
+            if (stale) load_recalc();
+            return 1;
+        }
+        if (in_read((char*)b + 1, 2) != 2 || b[0] >= MAX_COLS || b[1] >= MAX_ROWS) return 0;
+        if (!in_u16(&len)) return 0;
+
+        Cell* c = find_cell(b[0], b[1]);
+        if (!c) c = new_cell(b[0], b[1]);
+        if (!c) return 0;
+        free(c->content);
+        c->content = malloc(len + 1);
+        if (!c->content) {
+            error(errOutOfMemory.str);
+            return 0;
+        }
+        if (in_read(c->content, len) != len) return 0;
+        c->content[len] = 0;
+        c->flags = (c->flags & MSK_FORMULA) | (b[2] & FLG_FORMULA);
+        set_occ(b[0], b[1], 1);
+
+        Value* v = &c->cached;
+        free_val(v);
+        if (in_read((char*)b, 1) != 1) return 0;
+        v->type = b[0];
+        if (v->type == TYPE_NUM) {
+            if (in_read((char*)&v->num, sizeof(v->num)) != sizeof(v->num)) return 0;
+        } else if (v->type == TYPE_STR) {
+            if (!in_u16(&len)) return 0;
+            v->str = malloc(len + 1);
+            if (!v->str) {
+                v->type = TYPE_NULL;
+                error(errOutOfMemory.str);
+                return 0;
+            }
+            if (in_read(v->str, len) != len) return 0;
+            v->str[len] = 0;
+        } else if (v->type == TYPE_TEXT) {
+            if (c->flags & FLG_FORMULA) {
+                v->type = TYPE_NULL;
+                c->flags |= FLG_DIRTY;
+                stale = 1;
+            }
+            else {
+                v->str = c->content[0] == '\'' ? c->content + 1 : c->content;
+            }
+        } else if (v->type == TYPE_ERROR) {
+            if (in_read((char*)b, 1) != 1) return 0;
+            *v = *error_values[b[0] < ERROR_VALUE_COUNT ? b[0] : 0];
+        } else {
+            v->type = TYPE_NULL;
+        }
+
+        if (!in_u16(&len)) return 0;
+        while (len--) {
+            Cell* d = in_cell_ref();
+            if (!d) return 0;
+            add_dep(c, d);
+        }
+    }
+}
+
+/* Parse up to limit "A1:content" records in place in the input buffer, returns the number parsed */
+uint16_t load_text(uint16_t limit) MYCC {
+    uint16_t count = 0;
+    char* p;
+    while (count < limit) {
+        errno = 0;
+        if (!(p = in_line())) {
+            // a line too long for memory ends the load rather than being skipped
+            if (errno == ENOMEM) error(errOutOfMemory.str);
+            break;
+        }
+        if (load_row < 0 && !strcmp(p, ZSC_SORTED)) {
+            load_sorted = 1;
+            continue;
+        }
+        int col = *p - 'A';
+        if (col < 0 || col >= MAX_COLS) continue;   // also skips blank lines and headers
+        int row = 0;
+        while (isdigit(*++p) && row <= MAX_ROWS) row = row * 10 + *p - '0';
+        if (*p != ':' || row < 1 || row > MAX_ROWS) continue;
+        --row;
+        // in a row-major file a record past every existing cell is new, no lookup needed
+        if (load_sorted && row * MAX_COLS + col > max_cell_key && p[1]) {
+            Cell* c = new_cell(col, row);
+            if (c) update_cell(c, p + 1);
+        }
+        else {
+            set_cell(col, row, p + 1);
+        }
+        load_row = row;
+        ++count;
+    }
+    return count;
+}
+
+/* Replay the edits quick saved since the last full save */
+void load_journal(const char* filepath) MYCC {
+    journal_name(filepath);
+    errno = 0;
+    void* f = open_file(tmpbuffer);
+    if (errno) return;
+
+    in_open(f);
+    load_sorted = 0;
+    load_row = -1;
+    batch_begin();
+    journal_records = load_text(UINT16_MAX);
+    batch_commit();
+    in_close();
+    close_file(f);
+}
+
+/* Keep the content a background save has yet to write before a cell is edited,
+   returns 0 when there is no room and the save has to complete first */
+uint8_t save_protect(int c, int r) MYCC {
+    if (!save_file || r < save_row || r >= save_rows || save_copy_find(c, r)) return 1;
+    if (save_copy_count == MAX_SAVE_COPIES) return 0;
+    Cell* p = find_cell(c, r);
+    char* content = NULL;
+    if (p && p->content && *p->content) {
+        content = strdup(p->content);
+        if (!content) return 0;
+    }
+    SaveCopy* copy = &save_copies[save_copy_count++];
+    copy->col = c;
+    copy->row = r;
+    copy->content = content;
+    return 1;
+}
+
+/* Open a document and load it, a row-major text file only until a record
+   lies at or below stop_row. Returns 1 if load_more has records left. */
+uint8_t load_open(const char* filepath, int stop_row) MYCC {
+    errno = 0;
+    load_file = open_file(filepath);
+    if (errno) return 0;
+
+    in_open(load_file);
+    const char* magic = in_peek(4);
+    if (magic && !memcmp(magic, ZSB_MAGIC, 3)) {
+        in_read(tmpbuffer, 4);
+        if (tmpbuffer[3] != ZSB_VERSION || !load_binary()) error("Invalid file");
+        return 0;
+    }
+
+    load_sorted = 0;
+    load_row = -1;
+    load_size = file_size(load_file);
+    if (!load_size) load_size = 1;
+    batch_begin();
+    uint8_t more;
+    while ((more = load_text(LOAD_STEP) == LOAD_STEP) && load_sorted && load_row < stop_row);
+    batch_commit();
+    is_dirty = 0;
+    return more;
+}
+
+/* Load up to limit more records in one batch, returns 1 if records are left */
+uint8_t load_more(uint16_t limit) MYCC {
+    batch_begin();
+    uint16_t n = load_text(limit);
+    batch_commit();
+    is_dirty = 0;
+    return n == limit;
+}
+
+uint8_t load_progress(void) MYCC {
+    return in_tell() * 100 / load_size;
+}
+
+/* Close the document file and replay its journal */
+void load_end(void) MYCC {
+    if (load_file) {
+        in_close();
+        close_file(load_file);
+        load_file = NULL;
+    }
+    load_journal(filename);
+    is_dirty = 0; // clear dirty flag
+}
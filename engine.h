@@ -0,0 +1,170 @@
+#ifndef ENGINE_H__
+#define ENGINE_H__
+
+#include <stdint.h>
+
+#include "platform.h"
+
+// Cells, formulas and the document formats. Nothing here draws or reads
+// the keyboard, the front end supplies error, status and mark_changed.
+
+#define MAX_COLS    26
+#define MAX_ROWS    256
+#define CELL_W      11    // cell display width, also the longest string a formula builds
+
+#define CELL_TBL_SIZE  31 // size of hash table for cells
+
+#define FLG_DIRTY       1
+#define FLG_FORMULA     2
+#define FLG_EMPTY       4
+#define FLG_PENDING     8
+#define FLG_JOURNAL     16
+#define FLG_RECALC      32
+#define FLG_CHANGED     64
+#define FLG_VISITING    128
+
+#define MSK_DIRTY       (~FLG_DIRTY)
+#define MSK_FORMULA     (~FLG_FORMULA)
+#define MSK_EMPTY       (~FLG_EMPTY)
+#define MSK_PENDING     (~FLG_PENDING)
+#define MSK_JOURNAL     (~FLG_JOURNAL)
+#define MSK_RECALC      (~FLG_RECALC)
+#define MSK_CHANGED     (~FLG_CHANGED)
+#define MSK_VISITING    (~FLG_VISITING)
+
+#define MAX_JOURNAL_RECORDS 512 // journal records written before a quick save compacts into a full save
+#define LOAD_STEP           32  // records parsed per slice of a background load
+
+struct Cell;
+
+typedef enum { TYPE_NULL, TYPE_NUM, TYPE_STR, TYPE_TEXT, TYPE_ERROR } ValType;
+
+/* Generic value returned by evaluator */
+typedef struct Value {
+    ValType type;
+    union {
+        float  num;
+        char* str;     // allocated if TYPE_STR, not allocated if TYPE_TEXT or TYPE_ERROR
+    };
+} Value;
+
+typedef struct Dep {
+    struct Cell* cell;
+    struct Dep* next;
+} Dep;
+
+// One spreadsheet cell
+typedef struct Cell {
+    Dep* deps;          // cells this cell references
+    Dep* revdeps;       // cells referemcing this cell
+
+    int col, row;
+    char* content;      // raw text
+    Value cached;
+    char* disp;         // display rendering of cached owned by the front end, emptied when stale
+
+    uint8_t flags;
+} Cell;
+
+typedef struct HNode {
+    Cell* cell;
+    struct HNode* next;
+} HNode;
+
+typedef enum {
+    tokNone,
+    tokCellRef, tokRange, tokNumber, tokString,
+    tokEq, tokNe, tokLt, tokLe, tokGt, tokGe,
+    tokPlus, tokMinus, tokMul, tokDiv, tokMod, tokLParen, tokRParen, tokComma, tokEnd,
+    tokScalarFunc,
+    tokRangeFunc,
+
+    tokError,
+} TokenType;
+
+extern Value errInvalidArg;
+extern Value errExprInvalid;
+extern Value errExprDivZero;
+extern Value errExprCyclicRef;
+extern Value errExprExpectLParen;
+extern Value errExprExpectRParen;
+extern Value errExprExpectNumeric;
+extern Value errOutOfMemory;
+
+extern char* e_filename;
+extern uint8_t is_dirty;
+
+extern HNode* hash_table[CELL_TBL_SIZE];
+extern uint32_t row_occ[MAX_ROWS];
+extern uint8_t col_occ[MAX_COLS][MAX_ROWS / 8];
+extern int max_cell_key;
+
+extern TokenType tok_type;
+extern char token[32];
+extern char* expr;
+
+extern uint8_t journal_count;
+extern uint8_t journal_overflow;
+extern uint16_t journal_records;
+
+extern void* save_file;
+extern int save_row;
+extern int save_rows;
+
+extern void* load_file;
+
+// Provided by the front end
+void error(const char* fmt, ...);
+void status(const char* fmt, ...);
+void mark_changed(Cell* c);
+
+void engine_init(void);
+
+Value  make_num(float v);
+Value  make_str(const char* s);
+void   free_val(Value *v);
+uint8_t is_str_value(Value v);
+char* trim(char* s);
+
+Cell* find_cell(int col, int row);
+Cell* new_cell(int c, int r);
+void add_dep(Cell* owner, Cell* dep);
+void remove_deps(Cell* c);
+void propagate_dirty(Cell* c);
+void recalc(Cell* c);
+#if defined(MEMDBG) || defined(HOST) || defined(TICKS)
+void free_cells(void);
+#endif
+
+void next_char(void);
+void get_token(void);
+void parse_cellref(const char** sp, int* col, int* row);
+void parse_range(const char** sp, int* from_col, int* from_row, int* to_col, int* to_row);
+Value parse_expr(char* e);
+
+void build_deps(Cell* p);
+void set_cell(int c, int r, const char* s);
+void update_cell(Cell* p, const char* s);
+void eval_cell(Cell* c);
+void batch_begin(void);
+void batch_commit(void);
+
+void out_record(Cell* c) MYCC;
+void journal_note(Cell* c) MYCC;
+void journal_reset(void) MYCC;
+int journal_save(void) MYCC;
+
+uint8_t is_binary_file(const char* name) MYCC;
+int save_begin(void) MYCC;
+uint8_t save_step(uint16_t limit) MYCC;
+int save_end(void) MYCC;
+int do_save(void) MYCC;
+uint8_t save_protect(int c, int r) MYCC;
+
+uint16_t load_text(uint16_t limit) MYCC;
+uint8_t load_open(const char* filepath, int stop_row) MYCC;
+uint8_t load_more(uint16_t limit) MYCC;
+uint8_t load_progress(void) MYCC;
+void load_end(void) MYCC;
+
+#endif //ENGINE_H__
@@ -0,0 +1,113 @@
+// platform.h on stdio, for building the engine and bench/ on the host
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+
+#include "platform.h"
+
+char filename_buffer[261];
+char *filename = &filename_buffer[0];
+char tmpbuffer[256];
+
+static char block[BLOCK_SIZE];
+
+uint32_t write_calls;
+
+void cleanup(void) {
+}
+
+void init(void) {
+}
+
+const char* get_lfn(const char* filepath) {
+    strncpy(filename, filepath, 250);
+    filename[250] = 0;
+    return &filename[0];
+}
+
+// errno is only meaningful on failure in stdio, the engine tests it after every call
+static void* open_mode(const char* filename, const char* mode) {
+    errno = 0;
+    FILE* f = fopen(filename, mode);
+    if (!f) {
+        if (!errno) errno = EIO;
+        return NULL;
+    }
+    errno = 0;
+    return f;
+}
+
+void* open_file(const char* filename) {
+    return open_mode(filename, "rb");
+}
+
+void* create_file(const char* filename) {
+    return open_mode(filename, "wb");
+}
+
+void* append_file(const char* filename) {
+    return open_mode(filename, "ab");
+}
+
+void delete_file(const char* filename) {
+    remove(filename);
+}
+
+uint32_t file_size(void* file) {
+    if (!file) return 0;
+    long pos = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, pos, SEEK_SET);
+    return size < 0 ? 0 : size;
+}
+
+void close_file(void* file) {
+    if (file) fclose(file);
+}
+
+int read_file(void* file, char* buffer, size_t size) {
+    if (file) return fread(buffer, 1, size, file);
+    return 0;
+}
+
+int write_file(void* file, const char* buffer, size_t size) {
+    ++write_calls;
+    if (file) {
+        size_t bytes = fwrite(buffer, 1, size, file);
+        if (bytes != size && !errno) errno = EIO;
+        return bytes;
+    }
+    return 0;
+}
+
+void rename_file(const char* oldname, const char* newname) {
+    remove(newname); // remove old file if exists
+    errno = 0;
+    rename(oldname, newname);
+}
+
+char* itoa(int num, char* buf, int radix) {
+    char tmp[33];
+    unsigned n = num < 0 && radix == 10 ? -(unsigned)num : (unsigned)num;
+    char* p = tmp;
+    char* out = buf;
+    do {
+        *p++ = "0123456789abcdefghijklmnopqrstuvwxyz"[n % radix];
+        n /= radix;
+    } while (n);
+    if (num < 0 && radix == 10) *out++ = '-';
+    while (p > tmp) *out++ = *--p;
+    *out = 0;
+    return buf;
+}
+
+char* block_map(void) {
+    return block;
+}
+
+void block_unmap(void) {
+}
@@ -0,0 +1,253 @@
+// Engine checks on the host: make test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#include "platform.h"
+#include "engine.h"
+#include "numfmt.h"
+
+#define TEST_FILE   "/tmp/zxsheet_test"
+
+int failures;
+
+void error(const char* fmt, ...) {
+}
+
+void status(const char* fmt, ...) {
+}
+
+void mark_changed(Cell* c) {
+}
+
+void check(int ok, const char* what, ...) {
+    if (ok) return;
+    va_list args;
+    va_start(args, what);
+    printf("FAIL ");
+    vprintf(what, args);
+    printf("\n");
+    va_end(args);
+    ++failures;
+}
+
+void check_num(int col, int row, float expect) {
+    Cell* c = find_cell(col, row);
+    check(c && c->cached.type == TYPE_NUM && c->cached.num == expect,
+        "%c%d: expected %g, got type %d %s", 'A' + col, row + 1, expect,
+        c ? c->cached.type : -1, c && c->cached.type == TYPE_ERROR ? c->cached.str : "");
+}
+
+void check_str(int col, int row, const char* expect) {
+    Cell* c = find_cell(col, row);
+    check(c && is_str_value(c->cached) && strcmp(c->cached.str, expect) == 0,
+        "%c%d: expected \"%s\", got %s", 'A' + col, row + 1, expect,
+        c && c->cached.str && c->cached.type != TYPE_NUM ? c->cached.str : "a number");
+}
+
+// Save under name, clear the sheet and load it back
+void reload(const char* name) {
+    strcpy(filename, name);
+    e_filename = filename;
+    check(do_save() == 0, "save %s", name);
+    free_cells();
+    strcpy(filename, name);
+    if (load_open(filename, MAX_ROWS)) while (load_more(UINT16_MAX));
+    load_end();
+}
+
+/* Recalculation */
+
+void test_batch_order(void) {
+    free_cells();
+    batch_begin();
+    set_cell(0, 2, "=A2+1");
+    set_cell(0, 1, "=A1+1");
+    set_cell(0, 0, "1");
+    batch_commit();
+    check_num(0, 1, 2);
+    check_num(0, 2, 3);
+}
+
+void test_diamond(void) {
+    free_cells();
+    set_cell(0, 0, "1");
+    set_cell(1, 0, "=A1+1");
+    set_cell(2, 0, "=A1+B1");
+    set_cell(3, 0, "=B1*2");
+    set_cell(0, 0, "5");
+    check_num(1, 0, 6);
+    check_num(2, 0, 11);
+    check_num(3, 0, 12);
+}
+
+// Emptying a cell must not drop it from the lists it is queued in
+void test_clear_journal(void) {
+    free_cells();
+    journal_reset();
+    set_cell(0, 0, "1");
+    Cell* c = find_cell(0, 0);
+    journal_note(c);
+    set_cell(0, 0, "");
+    journal_note(c);
+    check(journal_count == 1, "A1 journaled once, got %d entries", journal_count);
+    journal_reset();
+}
+
+void test_cycle(void) {
+    free_cells();
+    set_cell(0, 0, "=B1+1");
+    set_cell(1, 0, "=A1+1");
+    Cell* c = find_cell(0, 0);
+    check(c && c->cached.type == TYPE_ERROR, "A1=B1+1, B1=A1+1 is a cycle");
+}
+
+// More cells than a batch tracks, so the commit scans the hash table
+void test_chain_reload(void) {
+    char buf[16];
+    free_cells();
+    set_cell(0, 0, "1");
+    for (int r = 1; r < MAX_ROWS; r++) {
+        sprintf(buf, "=A%d+1", r);
+        set_cell(0, r, buf);
+        sprintf(buf, "=SUM(A1:A%d)", r + 1);
+        set_cell(1, r, buf);
+    }
+    reload(TEST_FILE ".zsc");
+    for (int r = 0; r < MAX_ROWS; r++) check_num(0, r, r + 1);
+    check_num(1, 63, 64 * 65 / 2);
+    check_num(1, MAX_ROWS - 1, MAX_ROWS * (MAX_ROWS + 1) / 2);
+}
+
+void test_text_reload(void) {
+    free_cells();
+    set_cell(0, 0, "=B1");
+    set_cell(1, 0, "hello world");
+    reload(TEST_FILE ".zsc");
+    check_str(0, 0, "hello world");
+}
+
+// Cells edited during a background save are written as they were when it started
+void test_save_copy(void) {
+    free_cells();
+    set_cell(0, 0, "1");
+    set_cell(0, 4, "=A1+1");
+    set_cell(1, 4, "'text");
+    set_cell(0, 5, "=A5*2");
+    strcpy(filename, TEST_FILE ".zsc");
+    e_filename = filename;
+    check(save_begin() == 0, "save_begin");
+    save_step(1);
+    check(save_protect(0, 4) && save_protect(1, 4), "save_protect");
+    set_cell(0, 4, "7");
+    set_cell(1, 4, "");
+    while (!save_step(1));
+    check(save_end() == 0, "save_end");
+    free_cells();
+    if (load_open(filename, MAX_ROWS)) while (load_more(UINT16_MAX));
+    load_end();
+    check_num(0, 4, 2);
+    check_str(1, 4, "text");
+    check_num(0, 5, 4);
+    set_cell(0, 0, "3");
+    check_num(0, 5, 8);
+}
+
+/* Binary documents */
+
+void test_binary_text(void) {
+    free_cells();
+    set_cell(0, 0, "=B1");
+    set_cell(1, 0, "hello world");
+    set_cell(2, 0, "=A1");
+    set_cell(3, 0, "'quoted");
+    set_cell(4, 0, "=\"ab\"+D1");
+    reload(TEST_FILE ".zsb");
+    check_str(0, 0, "hello world");
+    check_str(1, 0, "hello world");
+    check_str(2, 0, "hello world");
+    check_str(3, 0, "quoted");
+    check_str(4, 0, "abquoted");
+}
+
+/* Occupancy */
+
+// Every content cell has its bit set in both the row and the column maps
+void check_occ(const char* when) {
+    int bad = 0;
+    for (int r = 0; r < MAX_ROWS; r++) {
+        for (int c = 0; c < MAX_COLS; c++) {
+            Cell* p = find_cell(c, r);
+            int used = p && p->content;
+            if (((row_occ[r] >> c) & 1) != used || ((col_occ[c][r >> 3] >> (r & 7)) & 1) != used) ++bad;
+        }
+    }
+    check(!bad, "%s: %d cells with occupancy bits out of step", when, bad);
+}
+
+void test_occupancy(void) {
+    free_cells();
+    set_cell(0, 0, "1");
+    set_cell(2, 7, "=A1+Z256");
+    set_cell(25, 255, "'last");
+    set_cell(3, 8, "x");
+    set_cell(3, 8, "");
+    check_occ("set_cell");
+    reload(TEST_FILE ".zsb");
+    check_occ("binary load");
+    reload(TEST_FILE ".zsc");
+    check_occ("text load");
+    free_cells();
+    check_occ("free_cells");
+}
+
+/* Number formatting */
+
+void check_fmt(float v, const char* expect) {
+    char buf[16];
+    fmt_num(buf, v, 12);
+    const char* p = buf;
+    while (*p == ' ') ++p;
+    check(strcmp(p, expect) == 0, "fmt_num(%.9g): expected %s, got %s", v, expect, p);
+}
+
+// Six significant digits, rounded once from the exact float
+void test_numfmt(void) {
+    check_fmt(75.6772461f, "75.6772");
+    check_fmt(7117.30469f, "7117.3");
+    check_fmt(-2.22729492f, "-2.22729");
+    check_fmt(9.46840479e22f, "9.4684e+22");
+    check_fmt(123456.789f, "123457");
+    check_fmt(9.9999996f, "10");
+    check_fmt(0.1f, "0.1");
+    check_fmt(1.17549435e-38f, "1.17549e-38");
+    check_fmt(3.40282347e38f, "3.40282e+38");
+}
+
+int main(void) {
+    engine_init();
+    init();
+
+    test_batch_order();
+    test_diamond();
+    test_cycle();
+    test_clear_journal();
+    test_chain_reload();
+    test_text_reload();
+    test_binary_text();
+    test_save_copy();
+    test_occupancy();
+    test_numfmt();
+
+    free_cells();
+    remove(TEST_FILE ".zsc");
+    remove(TEST_FILE ".zsb");
+    cleanup();
+    if (failures) printf("%d failed\n", failures);
+    else printf("All passed\n");
+    return failures != 0;
+}
@@ -14,218 +14,40 @@
 
 #include "platform.h"
 #include "crtio.h"
+#include "profile.h"
+#include "numfmt.h"
+#include "engine.h"
+#include "replay.h"
 
 #define VERSION "0.2"
 
-#define MAX_COLS    26
-#define MAX_ROWS    256
 #define VIEW_COLS   6     // viewport width 
 #define VIEW_ROWS   24    // viewport height
-#define CELL_W      11    // cell display width
-
-#define CELL_TBL_SIZE  31 // size of hash table for cells
 
 #define INPUT_LINE_ROW (SCREEN_HEIGHT - 6)
 #define STATUS_LINE_ROW (INPUT_LINE_ROW - 1)
 
-#define FLG_DIRTY       1
-#define FLG_FORMULA     2
-#define FLG_EMPTY       4
-#define FLG_VISITING    128
-
-#define MSK_DIRTY       (~FLG_DIRTY)
-#define MSK_FORMULA     (~FLG_FORMULA)
-#define MSK_EMPTY       (~FLG_EMPTY)
-#define MSK_VISITING    (~FLG_VISITING)
+#define MAX_CHANGED     32  // cells tracked for repaint before falling back to a full redraw
 
-#define MAX_FUNC_ARGS 5
+#define SAVE_STEP       32  // records written per idle slice of a background save
 
-typedef enum { REDRAW_ALL, REDRAW_CONTENT } REDRAW_MODE;
+typedef enum { 
+    REDRAW_ALL, REDRAW_CONTENT, REDRAW_CHANGED,
+    REDRAW_SCROLL_UP, REDRAW_SCROLL_DOWN, REDRAW_SCROLL_LEFT, REDRAW_SCROLL_RIGHT,
+} REDRAW_MODE;
 
 char ln[80];
-char* e_filename = NULL;
-uint8_t is_dirty = 0;
 uint8_t was_dirty = 0;
 uint8_t has_error = 0; // set if error occurred during evaluation
+uint8_t shown_progress = 0xff; // percentage on the status line, 0xff for anything else
 REDRAW_MODE redraw = REDRAW_ALL;
 
-struct Cell;
-
-typedef enum { TYPE_NULL, TYPE_NUM, TYPE_STR, TYPE_TEXT, TYPE_ERROR } ValType;
-
-/* Generic value returned by evaluator */
-typedef struct Value {
-    ValType type;
-    union {
-        float  num;
-        char* str;     // allocated if TYPE_STR, not allocated if TYPE_TEXT or TYPE_ERROR
-    };
-} Value;
-
-Value errInvalidArg = { .type = TYPE_ERROR };
-Value errExprInvalid = { .type = TYPE_ERROR };
-Value errExprDivZero = { .type = TYPE_ERROR };
-Value errExprCyclicRef = { .type = TYPE_ERROR };
-Value errExprExpectLParen = { .type = TYPE_ERROR };
-Value errExprExpectRParen = { .type = TYPE_ERROR };
-Value errExprExpectNumeric = { .type = TYPE_ERROR };
-Value errOutOfMemory = { .type = TYPE_ERROR };
-
-
-// Forward declarations
-Value  make_num(float v);
-Value  make_str(const char* s);
-
-void   free_val(Value *v);
-void error(const char* fmt, ...);
-void status(const char* fmt, ...);
-
-typedef struct Dep {
-    struct Cell* cell;
-    struct Dep* next;
-} Dep;
-
-// One spreadsheet cell
-typedef struct Cell {
-    Dep* deps;          // cells this cell references
-    Dep* revdeps;       // cells referemcing this cell
-
-    int col, row;
-    char* content;      // raw text
-    Value cached;
-
-    uint8_t flags;
-} Cell;
-
-typedef struct HNode {
-    Cell* cell;
-    struct HNode* next;
-} HNode;
-
-uint8_t is_str_value(Value v) {
-    return v.type == TYPE_STR || v.type == TYPE_TEXT;
-}
-
-HNode* hash_table[CELL_TBL_SIZE] = { 0 }; // hash table for cells
-
-Cell* find_cell(int col, int row) {
-    int h = (col + (row * 257)) % CELL_TBL_SIZE;
-    HNode* node = hash_table[h];
-    while (node) {
-        if (node->cell->col == col && node->cell->row == row) {
-            return node->cell;
-        }
-        node = node->next;
-    }
-    return NULL; // not found
-}
-
-void add_cell(Cell* cell) {
-    int h = (cell->col + (cell->row * 257)) % CELL_TBL_SIZE;
-    HNode* node = malloc(sizeof(HNode));
-    if (!node) {
-        error(errOutOfMemory.str);
-        return;
-    }
-    node->cell = cell;
-    node->next = hash_table[h];
-    hash_table[h] = node;
-}
-
-typedef void  (*PFN_ACCUM)(void* state, Cell* cell);
-typedef Value(*PFN_EVAL)(void* state);
-
-typedef enum {
-    tokNone,
-    tokCellRef, tokRange, tokNumber, tokString, 
-    tokEq, tokNe, tokLt, tokLe, tokGt, tokGe, 
-    tokPlus, tokMinus, tokMul, tokDiv, tokMod, tokLParen, tokRParen, tokComma, tokEnd,
-    tokScalarFunc,
-    tokRangeFunc,
-
-    tokError, 
-} TokenType;
-
-typedef struct Function {
-    const char* name;
-    PFN_ACCUM pfn_accum;    // function accumulator
-    PFN_EVAL pfn_eval;      // function evaluator
-    TokenType tok_type;     // token type for this function
-    uint8_t min_args;       // minimum number of arguments
-    uint8_t max_args;       // maximum number of arguments
-} Function;
-
-void sum_range(void* state, Cell* cell);
-Value sum_eval(void* state);
-Value avg_eval(void* state);
-void count_range(void* state, Cell* cell);
-Value count_eval(void* state);
-void max_range(void* state, Cell* cell);
-void min_range(void* state, Cell* cell);
-Value best_eval(void* state);
-
-Value sin_eval(void* state);
-Value cos_eval(void* state);
-Value tan_eval(void* state);
-Value asin_eval(void* state);
-Value acos_eval(void* state);
-Value atan_eval(void* state);
-
-Value abs_eval(void* state);
-Value ceil_eval(void* state);
-Value floor_eval(void* state);
-Value round_eval(void* state);
-Value trunc_eval(void* state);
-
-Value sqrt_eval(void* state);
-Value exp_eval(void* state);
-Value log_eval(void* state);
-Value log10_eval(void* state);
-Value log2_eval(void* state);
-
-Value dec2bin_eval(void* state);
-Value bin2dec_eval(void* state);
-Value dec2hex_eval(void* state);
-Value hex2dec_eval(void* state);
-
-Value if_eval(void* state);
-
-Function functions[] = {
-    { "SUM", sum_range, sum_eval, tokRangeFunc, 1, 1},
-    { "AVG", sum_range, avg_eval, tokRangeFunc, 1, 1 },
-    { "COUNT", count_range, count_eval, tokRangeFunc, 1, 1 },
-    { "MAX", max_range, best_eval, tokRangeFunc, 1, 1 },
-    { "MIN", min_range, best_eval, tokRangeFunc, 1, 1 },
-    { "SIN", NULL, sin_eval, tokScalarFunc, 1, 1},
-    { "COS", NULL, cos_eval, tokScalarFunc, 1, 1},
-    { "TAN", NULL, tan_eval, tokScalarFunc, 1, 1},
-    { "ASIN", NULL, asin_eval, tokScalarFunc, 1, 1},
-    { "ACOS", NULL, acos_eval, tokScalarFunc, 1, 1},
-    { "ATAN", NULL, atan_eval, tokScalarFunc, 1, 1},
-    { "ABS", NULL, abs_eval, tokScalarFunc, 1, 1},
-    { "CEIL", NULL, ceil_eval, tokScalarFunc, 1, 1},
-    { "FLOOR", NULL, floor_eval, tokScalarFunc, 1, 1},
-    { "ROUND", NULL, round_eval, tokScalarFunc, 1, 1},
-    { "TRUNC", NULL, trunc_eval, tokScalarFunc, 1, 1},
-    { "SQRT", NULL, sqrt_eval, tokScalarFunc, 1, 1},
-    { "EXP", NULL, exp_eval, tokScalarFunc, 1, 1},
-    { "LOG", NULL, log_eval, tokScalarFunc, 1, 1},
-    { "LOG10", NULL, log10_eval, tokScalarFunc, 1, 1},
-    { "LOG2", NULL, log2_eval, tokScalarFunc, 1, 1},
-    { "DEC2BIN", NULL, dec2bin_eval, tokScalarFunc, 1, 1},
-    { "BIN2DEC", NULL, bin2dec_eval, tokScalarFunc, 1, 1},
-    { "DEC2HEX", NULL, dec2hex_eval, tokScalarFunc, 1, 1},
-    { "HEX2DEC", NULL, hex2dec_eval, tokScalarFunc, 1, 1},
-    { "IF", NULL, if_eval, tokScalarFunc, 3, 3},
-
-    { NULL, NULL }  /* sentinel */
-};
+Cell* changed[MAX_CHANGED];     // cells whose value changed since the last print_view
+uint8_t changed_count = 0;
 
-TokenType tok_type;
-char token[32];
-char* expr;
-char ch;
-Function* current_function;
+/* Globals */
+static int view_r = 0, view_c = 0;
+static int ccol = 0, crow = 0;
 
 void error(const char* fmt, ...) {
     uint8_t ox, oy;
@@ -254,1031 +76,32 @@ void status(const char* fmt, ...) {
     set_cursor_pos(0, STATUS_LINE_ROW);
     prints(ln); clreol();
     set_cursor_pos(ox, oy);
+    screen_flip(); // show it before the long operation that usually follows
+    shown_progress = 0xff;
 }
 
-void next_char(void) {
-    ch = *expr;
-    if (ch == 0) return;
-    ++expr;
-}
-
-void parse_cellref(const char** sp, int* col, int* row);
-void parse_range(const char** sp, int* from_col, int* from_row, int* to_col, int* to_row);
-
-uint8_t is_cellref(const char* s) {
-    int n = 0;
-    if (!isalpha(*s)) return 0;
-    ++s;
-    if (!isdigit(*s)) return 0;
-    while (isdigit(*s)) {
-        n = n * 10 + (*s - '0');
-        ++s;
-    }
-    if (n < 1 || n > MAX_ROWS) return 0;
-    return *s == 0;
-}
-
-void get_token(void) {
-    tok_type = tokNone;
-
-    while (isspace(ch)) next_char();
-    if (ch == 0) {
-        tok_type = tokEnd;
-        return;
-    }
-    if (isalpha(ch)) {
-        int i = 0;
-        while (isalpha(ch) || isdigit(ch)) {
-            if (i < sizeof(token) - 1)
-                token[i++] = toupper(ch);
-            next_char();
-        }
-        token[i] = 0;
-        if (is_cellref(token)) {
-            tok_type = tokCellRef;
-            if (ch == ':') {
-                token[i++] = ch; // include ':' in token
-                next_char(); // skip ':'
-                char* s = token + i;
-                while (isalpha(ch) || isdigit(ch)) {
-                    if (i < sizeof(token) - 1)
-                        token[i++] = toupper(ch);
-                    next_char();
-                }
-                token[i] = 0;
-                if (!is_cellref(s)) {
-                    tok_type = tokError;
-                    return;
-                }
-                tok_type = tokRange;
-            }
-        }
-        else {
-            for (Function* f = functions; f->name; f++) {
-                if (strcmp(f->name, token) == 0) {
-                    tok_type = f->tok_type;
-                    current_function = f;
-                    break;
-                }
-            }
-        }
-        if (tok_type == tokNone) tok_type = tokError;
-    }
-    else if (isdigit(ch)) {
-        int i = 0;
-        while (isdigit(ch)) {
-            if (i < sizeof(token) - 1)
-                token[i++] = ch;
-            next_char();
-        }
-        if (ch == '.') {
-            if (i < sizeof(token) - 1)
-                token[i++] = ch;
-            next_char();
-            while (isdigit(ch)) {
-                if (i < sizeof(token) - 1)
-                    token[i++] = ch;
-                next_char();
-            }
-        }
-        token[i] = 0;
-        tok_type = tokNumber;
-    }
-    else {
-        switch (ch) {
-            case '=': tok_type = tokEq; next_char(); break;
-            case '<': 
-            next_char();
-            if (ch == '=') {
-                tok_type = tokLe; next_char();
-            } else if (ch == '>') {
-                tok_type = tokNe; next_char();
-            }
-            else {
-                tok_type = tokLt;
-            }
-            break;
-            case '>':
-                next_char();
-                if (ch == '=') {
-                    tok_type = tokGe; next_char();
-                }
-                else {
-                    tok_type = tokGt;
-                }
-            break;                
-            case '+': tok_type = tokPlus; next_char(); break;
-            case '-': tok_type = tokMinus; next_char(); break;
-            case '*': tok_type = tokMul; next_char(); break;
-            case '/': tok_type = tokDiv; next_char(); break;
-            case '%': tok_type = tokMod; next_char(); break;
-            case '(': tok_type = tokLParen; next_char(); break;
-            case ')': tok_type = tokRParen; next_char(); break;
-            case ',': tok_type = tokComma; next_char(); break;
-            case '\'': // string literal start
-            case '"': 
-                {
-                    char quote = ch;
-                    int i = 0;
-                    next_char();
-                    while (ch && ch != quote) {
-                        if (i < sizeof(token) - 1)
-                            token[i++] = ch;
-                        next_char();
-                    }
-                    if (ch == quote) {
-                        next_char(); // skip closing quote
-                        token[i] = 0;
-                        tok_type = tokString;
-                    }
-                    else {
-                        tok_type = tokError; // unterminated string
-                    }
-                }
-                break;
-            default:
-                tok_type = tokError;
-                break;
-        }
-    }
-}
-
-uint8_t expect_token(TokenType expected) {
-    if (tok_type != expected) {
-        return 0;
-    }
-    get_token();
-    return 1;
-}
-
-char* trim(char* s);
-
-/* Globals */
-static int view_r = 0, view_c = 0;
-static int ccol = 0, crow = 0;
-
-/* Helpers for Value */
-Value make_num(float v) {
-    Value x; x.type = TYPE_NUM; x.num = v; return x;
-}
-
-Value make_str(const char* s) {
-    Value x; x.type = TYPE_STR;
-    if (s) x.str = strdup(s); else x.str = NULL;
-    return x;
-}
-
-void free_val(Value *v) {
-    if (v->type == TYPE_STR && v->str) {
-        free(v->str);        
-    }
-    v->type = TYPE_NULL;
-    v->str = NULL;
-}
-
-// Trim leading/trailing space
-char* trim(char* s) {
-    char* p = s + strlen(s) - 1;
-    while (p >= s && isspace(*p)) *p-- = 0;
-    p = s;
-    while (*p && isspace(*p)) p++;
-    return p;
-}
-
-Cell* new_cell(int c, int r) {
-    Cell* p = calloc(1, sizeof(Cell));
-    if (p == NULL) {
-        error(errOutOfMemory.str);
-        return NULL;
-    }
-    p->col = c; p->row = r;
-    add_cell(p);
-    return p;
-}
-
-void remove_revdep(Cell* c, Cell* dep) {
-    Dep** pp = &c->revdeps;
-    while (*pp && (*pp)->cell != dep) pp = &(*pp)->next;
-    if (*pp) {
-        Dep* t = *pp; *pp = t->next; // unlink
-        free(t);
-    }
-}
-
-void remove_deps(Cell* c) {
-    Dep* d = c->deps;
-    while (d) {
-        Dep* t = d; d = d->next;
-        remove_revdep(t->cell, c);
-        free(t);
-    }
-    c->deps = NULL;
-}
-
-#ifdef MEMDBG
-void free_deplist(Dep *d) {
-    while (d) {
-        Dep* t = d; d = d->next;
-        free(t);
-    }        
-}
-
-void remove_cell(Cell* cell) {
-    int h = (cell->col + (cell->row * 257)) % CELL_TBL_SIZE;
-    HNode* node = hash_table[h];
-    HNode* prev = NULL;
-
-    free_deplist(cell->deps);
-    free_deplist(cell->revdeps);
-    while (node) {
-        if (node->cell == cell) {
-            if (prev) {
-                prev->next = node->next;
-            }
-            else {
-                hash_table[h] = node->next;
-            }
-            free(node);
-            return;
-        }
-        prev = node;
-        node = node->next;
-    }
-}
-
-void free_cell(Cell* c) {
-    if (c->content) free(c->content);
-    free_val(&c->cached);
-    remove_cell(c);
-    free(c);
-}
-
-void free_cells(void) {
-    for (int i = 0; i < CELL_TBL_SIZE; i++) {
-        HNode* node = hash_table[i];
-        while (node) {
-            HNode* next = node->next;
-            Cell* c = node->cell;
-            free_cell(c);            
-            node = next;
-        }
-        hash_table[i] = NULL; // clear the hash table entry
-    }
-}
-#endif //MEMDBG
-
-/* Add owner→dependency link both ways */
-void add_dep(Cell* owner, Cell* dep) {
-    Dep* d = malloc(sizeof * d);
-    if (d == NULL) {
-        error(errOutOfMemory.str);
-        return;
-    }
-    d->cell = dep; d->next = owner->deps; owner->deps = d;
-    Dep* r = malloc(sizeof * r);
-    if (d == NULL) {
-        error(errOutOfMemory.str);
-        return;
-    }
-    r->cell = owner; r->next = dep->revdeps; dep->revdeps = r;
-}
-
-/* Mark c and all its dependents dirty */
-void propagate_dirty(Cell* c) {
-    if (!(c->flags & FLG_DIRTY)) {
-        c->flags |= FLG_DIRTY;
-        for (Dep* d = c->revdeps; d; d = d->next)
-            propagate_dirty(d->cell);
-    }
-}
-
-/* Evaluate a cell (with caching & cycle detect) */
-void eval_cell(Cell* c);
-Value eval_expr(void);
-Value eval_expr1(void);
-Value eval_term(void);
-Value eval_factor(void);
-
-void parse_cellref(const char** sp, int* col, int* row) {
-    char ref[8] = { 0 };
-    int i = 0;
-    if (isalpha(**sp)) {
-        ref[i++] = toupper(*(*sp)++);
-        while (isdigit(**sp) && i < 7) ref[i++] = *(*sp)++;
-    }
-    ref[i] = 0;
-    *col = ref[0] - 'A';
-    *row = atoi(ref + 1) - 1;
-}
-
-void parse_range(const char** sp, int* from_col, int* from_row, int* to_col, int* to_row) {
-    int c1, r1, c2, r2;
-    parse_cellref(sp, &c1, &r1);
-    if (**sp == ':') (*sp)++;
-    parse_cellref(sp, &c2, &r2);
-    if (c2 < c1) { int t = c1; c1 = c2; c2 = t; }
-    if (r2 < r1) { int t = r1; r1 = r2; r2 = t; }
-    *from_col = c1; *from_row = r1;
-    *to_col = c2; *to_row = r2;
-}
-
-typedef struct {
-    float total;
-    float best;
-    int count;
-} AccumState;
-
-void sum_range(void* state, Cell* cell) {
-    AccumState* acc = (AccumState*)state;
-
-    Value dv = cell->cached;
-    if (dv.type == TYPE_NUM) {
-        acc->total += dv.num;
-        acc->count++;
-    }
-}
-
-Value sum_eval(void* state) {
-    AccumState* acc = (AccumState*)state;
-    Value v = make_num(acc->total);
-    return v;
-}
-
-Value avg_eval(void* state) {
-    AccumState* acc = (AccumState*)state;
-    Value v = make_num(acc->count ? acc->total / acc->count : 0);
-    return v;
+/* Show the progress of a background load or save, each flip waits for the
+   vertical blank so only repaint when the percentage moves */
+void show_progress(const char* what, uint8_t pct) MYCC {
+    if (pct == shown_progress) return;
+    status("%s %d%%", what, pct);
+    shown_progress = pct;
 }
 
-void count_range(void* state, Cell* cell) {
-    AccumState* acc = (AccumState*)state;
-    Value v = cell->cached;
-    if (v.type == TYPE_NULL || v.type == TYPE_ERROR) {
-        return; // skip null or error values
-    }
-    if (v.type == TYPE_NUM || (v.str && *v.str)) {
-        acc->count++;
-    }
-}
-
-Value count_eval(void* state) {
-    AccumState* acc = (AccumState*)state;
-    Value v = make_num((float)acc->count);
-    return v;
-}
-
-void max_range(void* state, Cell* cell) {
-    AccumState* acc = (AccumState*)state;
-    Value v = cell->cached;
-    if (v.type == TYPE_NUM) {
-        if (acc->count == 0 || v.num > acc->best) {
-            acc->best = v.num;
-        }
-        acc->count++;
-    }
-}
-
-void min_range(void* state, Cell* cell) {
-    AccumState* acc = (AccumState*)state;
-    Value v = cell->cached;
-    if (v.type == TYPE_NUM) {
-        if (acc->count == 0 || v.num < acc->best) {
-            acc->best = v.num;
-        }
-        acc->count++;
-    }
-}
-
-Value best_eval(void* state) {
-    AccumState* acc = (AccumState*)state;
-    Value v = make_num(acc->best);
-    return v;
-}
-
-Value sin_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(sinf(arg.num));
-    return v;
-}
-
-Value cos_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(cosf(arg.num));
-    return v;
-}
-Value tan_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(tanf(arg.num));
-    return v;
-}
-Value asin_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(asinf(arg.num));
-    return v;
-}
-Value acos_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(acosf(arg.num));
-    return v;
-}
-Value atan_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(atanf(arg.num));
-    return v;
-}
-
-Value abs_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(fabsf(arg.num));
-    return v;
-}
-Value ceil_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(ceilf(arg.num));
-    return v;
-}
-Value floor_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(floorf(arg.num));
-    return v;
-}
-Value round_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num((float)(int)(arg.num + 0.5));
-    return v;
-}
-Value trunc_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(truncf(arg.num));
-    return v;
-}
-
-Value sqrt_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(sqrtf(arg.num));
-    return v;
-}
-Value exp_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(expf(arg.num));
-    return v;
-}
-Value log_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(logf(arg.num));
-    return v;
-}
-Value log10_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(log10f(arg.num));
-    return v;
-}
-Value log2_eval(void* state) {
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    Value v = make_num(log2f(arg.num));
-    return v;
-}
-
-Value dec2bin_eval(void* state) {
-    char b[32];
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    int n = (int)arg.num;
-    itoa(n, b, 2);
-    Value v = make_str(b);
-    return v;
-}
-
-Value bin2dec_eval(void* state) {
-    Value arg = *(Value*)state;
-    char* endptr;
-    if (!is_str_value(arg)) return errInvalidArg;
-    int n = (int)strtol(arg.str, &endptr, 2);
-
-    if (*endptr != '\0') return errExprInvalid;
-
-    Value v = make_num((float)n);
-    return v;
-}
-
-Value dec2hex_eval(void* state) {
-    char b[32];
-    Value arg = *(Value*)state;
-    if (arg.type != TYPE_NUM) return errExprExpectNumeric;
-    int n = (int)arg.num;
-    itoa(n, b, 16);
-    Value v = make_str(b);
-    return v;
-}
-
-Value hex2dec_eval(void* state) {
-    Value arg = *(Value*)state;
-    char* endptr;
-    if (is_str_value(arg)) return errInvalidArg;
-    int n = (int)strtol(arg.str, &endptr, 16);
-
-    if (*endptr != '\0') return errExprInvalid;
-
-    Value v = make_num((float)n);
-    return v;
-}
-
-Value if_eval(void* state) {
-    Value* args = (Value*)state;
-    if (args[0].type != TYPE_NUM) {
-        return errExprExpectNumeric;
-    }
-    Value v = args[args[0].num ? 1 : 2]; // return true or false branch
-    return v;
-}
-    
-
-void set_range_dep(void* state, Cell* cell) {
-    Cell* root = (Cell*)state;
-    if (cell->flags & FLG_EMPTY) {
-        cell = new_cell(cell->col, cell->row);
-    }
-    add_dep(root, cell);
-}
-
-Value process_range(
-    int c1, int r1, int c2, int r2,
-    void* state,
-    PFN_ACCUM pfnAccum,
-    PFN_EVAL pfnEval) {
-
-    Cell empty = { 0 };
-    empty.flags |= FLG_EMPTY;
-
-    for (int cc = c1; cc <= c2; cc++) {
-        for (int rr = r1; rr <= r2; rr++) {
-            Cell* cell = find_cell(cc, rr);
-            if (!cell) {
-                cell = &empty;  /* use empty cell if not found */
-                empty.col = cc;
-                empty.row = rr;
-            }
-            pfnAccum(state, cell);
-        }
-    }
-    Value x;
-    if (pfnEval) {
-        x = pfnEval(state);
-    }
-    else {
-        x = make_num(0);  /* default to zero if no final fn */
-    }
-    return x;
-}
-
-/* Assignment: text may be formula, pure-number, or string */
-void set_cell(int c, int r, const char* s) {
-    Cell* p = find_cell(c, r);
-    if (!p && (!s || !*s)) return; // no cell, no text -> nothing to do
-
-    if (!p) {
-        p = new_cell(c, r);
-        if (!p) {
-            error(errOutOfMemory.str);
-            return;
-        }
-    }
-    else if (p->content) {
-        if (s && strcmp(p->content, s) == 0) return; // No change -> nothing to do
-        free(p->content);
-    }
-    
-    char* txt = (char*)s;
-    if (txt) txt = trim(txt);
-    if (!txt || !*txt) {
-        free_val(&p->cached);
-        p->content = NULL;
-        p->flags = 0;
-        
-        remove_deps(p);
-        goto reevaluate;
-    }
-
-    /* detect formula vs numeric vs string */
-    if (*txt == '=') {
-        p->flags |= FLG_FORMULA;
-        p->content = strdup(txt);
-    }
-    else if (*txt =='\'') {
-        /* string literal */
-        p->flags &= MSK_FORMULA; // clear formula flag
-        p->content = strdup(txt);
-        if (p->content == NULL) {
-            error(errOutOfMemory.str);
-            return;
-        }
-    }
-    else {
-        char* end;
-        float v = strtof(txt, &end);
-        if (end > txt && *end == 0) {
-            /* pure number → treat as single-term formula */
-            p->flags |= FLG_FORMULA;
-            p->content = malloc(strlen(txt) + 2);
-            if (!p->content) {
-                error(errOutOfMemory.str);
-                return;
-            }
-            sprintf(p->content, "=%s", txt);
-        }
-        else {
-            /* string */
-            p->flags &= MSK_FORMULA;
-            p->content = strdup(txt);
-            if (p->content == NULL) {
-                error(errOutOfMemory.str);
-                return;
-            }            
-        }
-    }
-    /* rebuild dependencies */
-    remove_deps(p);
-    if (p->flags & FLG_FORMULA) {
-        expr = p->content + 1;
-        next_char();
-        get_token();
-        while (tok_type != tokEnd && tok_type != tokError) {
-            const char* ref = &token[0];
-
-            if (tok_type == tokCellRef) {
-                /* single cell reference */
-                int cc, rr;
-                parse_cellref(&ref, &cc, &rr);
-                Cell* d = find_cell(cc, rr);
-                if (!d) d = new_cell(cc, rr);
-                add_dep(p, d);
-            }
-            else if (tok_type == tokRange) {
-                /* range reference */
-                int c1, r1, c2, r2;
-                parse_range(&ref, &c1, &r1, &c2, &r2);
-                Value v = process_range(
-                    c1, r1, c2, r2,
-                    p,
-                    set_range_dep,
-                    NULL);
-                free_val(&v);
-            }
-            get_token();
-        }
-    }
-
-reevaluate:
-    is_dirty = 1; // mark spreadsheet dirty
-    propagate_dirty(p);
-    eval_cell(p); // force evaluation
-}
-
-Value parse_expr(char* e) {
-    expr = e;
-    next_char();
-    get_token();
-    Value v;
-    v = eval_expr();    
-    return v;
-}
-
-/* Grammar: expr = expr {relop expr} */
-Value eval_expr(void) {
-    Value v = eval_expr1();
-    if (v.type == TYPE_ERROR) return v; // propagate error
-    Value res = v;
-    while (tok_type == tokEq || tok_type == tokNe || tok_type == tokLt || tok_type == tokLe || tok_type == tokGt || tok_type == tokGe) {
-        TokenType op = tok_type;
-        get_token();  // skip operator
-        Value v2 = eval_expr1();
-
-        if (v2.type == TYPE_ERROR) return v2; // propagate error
-
-        if (v.type == TYPE_NULL && v2.type == TYPE_NULL) {
-            res = make_num(1); // nulls are equal            
-        }
-        else {
-            int cmp = 0;
-            if (is_str_value(v) && is_str_value(v2)) {
-                cmp = strcmp(v.str, v2.str);
-            }
-            else {
-                float n1 = (v.type == TYPE_NUM ? v.num : v.str ? strtof(v.str, NULL) : 0);
-                float n2 = (v2.type == TYPE_NUM ? v2.num : v2.str ? strtof(v2.str, NULL) : 0);
-                cmp = (n1 < n2 ? -1 : (n1 > n2 ? 1 : 0));
-            }
-            switch (op) {
-                case tokEq:
-                    res = make_num((float)(cmp == 0));
-                    break;
-                case tokNe:
-                    res = make_num((float)(cmp != 0));
-                    break;
-                case tokLt:
-                    res = make_num((float)(cmp < 0));
-                    break;
-                case tokLe:
-                    res = make_num((float)(cmp <= 0));
-                    break;
-                case tokGt:
-                    res = make_num((float)(cmp > 0));
-                    break;
-                case tokGe:
-                    res = make_num((float)(cmp >= 0));
-                    break;
-            }
-        }
-        free_val(&v); free_val(&v2);
-        v = res;  // continue with the result
-    }
-    return res;
-}
-
-/* Grammar: expr = term {(+|-) term} */
-Value eval_expr1(void) {
-    Value v = eval_term();
-    if (v.type == TYPE_ERROR) return v; // propagate error
-    Value res = v;
-    while (tok_type == tokPlus || tok_type == tokMinus) {
-        TokenType op = tok_type;
-        get_token();  // skip operator
-        Value v2 = eval_term();
-        if (v2.type == TYPE_ERROR) return v2; // propagate error
-        if (op == tokPlus && (is_str_value(v) || is_str_value(v2))) {
-            char buf[CELL_W] = { 0 }, tmp1[CELL_W] = { 0 }, tmp2[CELL_W] = { 0 };
-            
-            if (is_str_value(v)) {
-                if (v.str) strncpy(tmp1, v.str, CELL_W);
-            }
-            else sprintf(tmp1, "%g", v.num);
-
-            if (is_str_value(v2)) {
-                if (v2.str) strncpy(tmp2, v2.str, CELL_W);
-            }
-            else sprintf(tmp2, "%g", v2.num);
-
-            snprintf(buf, sizeof(buf), "%s%s", tmp1, tmp2);
-            res = make_str(buf);
-        }
-        else {
-            float n1 = (v.type == TYPE_NUM ? v.num : v.str ? strtof(v.str, NULL) : 0);
-            float n2 = (v2.type == TYPE_NUM ? v2.num : v2.str ? strtof(v2.str, NULL) : 0);
-            switch (op) {
-                case tokPlus:
-                    res = make_num(n1 + n2);
-                    break;
-                case tokMinus:
-                    res = make_num(n1 - n2);
-                    break;
-            }
-        }
-        free_val(&v); free_val(&v2);
-        v = res;  // continue with the result
-    }
-    return res;
-}
-
-/* term = factor {(*|/) factor} */
-Value eval_term(void) {
-    Value v = eval_factor();
-    if (v.type == TYPE_ERROR) return v; // propagate error
-    Value res = v;
-    while (tok_type == tokMul || tok_type == tokDiv || tok_type == tokMod) {
-        TokenType op = tok_type;
-        get_token();  // skip operator
-        Value v2 = eval_factor();
-        if (v2.type == TYPE_ERROR) return v2; // propagate error
-        float n1 = (v.type == TYPE_NUM ? v.num : v.str ? strtof(v.str, NULL) : 0);
-        float n2 = (v2.type == TYPE_NUM ? v2.num : v2.str ? strtof(v2.str, NULL) : 0);
-        switch (op) {
-            case tokMul:
-                res = make_num(n1 * n2);
-                break;
-            case tokDiv:
-                if (n2 == 0)
-                    res = errExprDivZero;
-                else
-                    res = make_num(n1 / n2);
-                break;
-            case tokMod:
-                if (n2 == 0)
-                    res = errExprDivZero;
-                else
-                    res = make_num(fmodf(n1, n2));
-                break;
-        }
-        free_val(&v); free_val(&v2);
-        v = res;  // continue with the result
-    }
-    return res;
-}
-
-/* factor = num | ref | AVG(range) | '('expr')' */
-Value eval_factor(void) {
-    Value v = { 0 };
-    uint8_t negative = 0;
-    while (tok_type == tokMinus || tok_type == tokPlus) {
-        if (tok_type == tokMinus) {
-            negative = !negative;  // toggle sign
-        }
-        get_token();  // skip sign
-    }
-
-    switch (tok_type) {
-        case tokError:
-            v = errExprInvalid;
-            break;
-        case tokLParen: {
-            get_token();  // skip '('
-            v = eval_expr();
-            if (v.type == TYPE_ERROR) break;
-
-            if (!expect_token(tokRParen)) {
-                v = errExprExpectRParen;
-                break;
-            }
-        }
-                      break;
-
-        case tokNumber: {
-            float num = strtof(token, NULL);
-            get_token();  // skip number
-            v = make_num(num);
-        }
-                      break;
-
-        case tokCellRef: {
-            int cc, rr;
-            const char* ref = &token[0];
-            parse_cellref(&ref, &cc, &rr);
-            Cell* c = find_cell(cc, rr);
-            if (c) v = c->cached;
-            get_token();  // skip cell reference            
-        }
-                       break;
-
-        case tokRangeFunc: {
-            get_token();
-
-            if (!expect_token(tokLParen)) {
-                v = errExprExpectLParen;
-                break;
-            }
-
-            int c1, r1, c2, r2;
-            char* ref = &token[0];
-            parse_range(&ref, &c1, &r1, &c2, &r2);            
-            get_token();  // skip range
-
-            if (!expect_token(tokRParen)) {
-                v = errExprExpectRParen;
-                break;
-            }
-
-            AccumState acc = { .total = 0, .count = 0 };
-            v = process_range(c1, r1, c2, r2, &acc, current_function->pfn_accum, current_function->pfn_eval);
-        }
-                         break;
-
-        case tokScalarFunc: {
-            get_token();  // skip function name
-            Function* local_function = current_function;
-
-            if (!expect_token(tokLParen)) {
-                v = errExprExpectLParen;
-                break;
-            }
-
-            Value args[MAX_FUNC_ARGS];
-            memset(args, 0, sizeof(args));
-
-            int arg_count = 0;
-            while (arg_count < MAX_FUNC_ARGS) {
-                Value arg = eval_expr();
-                if (arg.type == TYPE_ERROR) {
-                    v = arg;  // error to propagate
-                    break;
-                }
-                args[arg_count++] = arg;
-
-                if (tok_type != tokComma) break;
-                get_token(); // skip comma                
-            }
-
-            if (arg_count < local_function->min_args || arg_count > local_function->max_args) {
-                v = errInvalidArg; // invalid number of arguments
-                break;
-            }
-
-
-            if (v.type == TYPE_ERROR) {
-                break; // propagate error
-            }
-
-            v = local_function->pfn_eval(args);
-
-            if (!expect_token(tokRParen)) {
-                v = v = errExprExpectRParen;
-                break;
-            }
-        } 
-        break;
-        
-        case tokString:
-            v = make_str(token);
-            if (v.str == NULL) {
-                v = errOutOfMemory; // handle memory allocation failure
-            }
-            get_token();  // skip string
-        break;
-
-        default:
-            v = errExprInvalid; // unexpected token
-            break;
-    }
-
-    if (negative) {
-        if (v.type == TYPE_NUM) {
-            v.num = -v.num;
-        }
-    }
-    return v;
+uint8_t in_view(int col, int row) {
+    return col >= view_c && col < view_c + VIEW_COLS && row >= view_r && row < view_r + VIEW_ROWS;
 }
 
-// Evaluate cell and its dependencies, caching the result
-void eval_cell(Cell* c) {
-    if (!c) {
-        return;
-    }
-
-    if (!(c->flags & FLG_DIRTY)) {
+/* Queue a cell for repaint by the next print_view, cells out of view are
+   painted when a scroll exposes them */
+void mark_changed(Cell* c) {
+    if (redraw < REDRAW_CHANGED || (c->flags & FLG_CHANGED) || !in_view(c->col, c->row)) return;
+    if (changed_count == MAX_CHANGED) {
+        redraw = redraw == REDRAW_CHANGED ? REDRAW_CONTENT : REDRAW_ALL;
         return;
     }
-
-    free_val(&c->cached);
-    if (!(c->flags & FLG_FORMULA)) {
-        if (c->content) {
-            c->cached.type = TYPE_TEXT;
-            if (*c->content == '\'')
-                c->cached.str = c->content + 1; // skip leading quote
-            else                            
-                c->cached.str = c->content;
-        }
-        else {
-            c->cached.type = TYPE_NULL;
-        }
-    }
-    else if (c->flags & FLG_VISITING) {
-        c->cached = errExprCyclicRef;
-    }
-    else {
-        c->flags |= FLG_VISITING;
-        if (c->deps) {
-            // ensure all dependencies are evaluated
-            for (Dep* d = c->deps; d; d = d->next) {                
-                eval_cell(d->cell);
-            }
-        }
-
-        if (c->flags & FLG_DIRTY) {
-            Value v = parse_expr(c->content + 1);
-
-            c->cached.type = v.type;
-          
-            if (v.type == TYPE_STR) { // DO NOT USE is_str_value, it checks for TYPE_TEXT
-                c->cached.str = v.str ? strdup(v.str) : NULL;
-            }
-            else {
-                c->cached = v; // propagate non-allocated value
-            }
-        }
-        c->flags &= MSK_VISITING; // reset visiting flag
-    }
-    c->flags &= (MSK_DIRTY & MSK_VISITING);
-
-    if (c->revdeps) {
-        // ensure all reverse dependencies are evaluated
-        for (Dep* d = c->revdeps; d; d = d->next) {
-            eval_cell(d->cell);
-        }
-    }
+    c->flags |= FLG_CHANGED;
+    changed[changed_count++] = c;
 }
 
 typedef enum CommandAction {
@@ -1293,18 +116,32 @@ typedef enum CommandAction {
 typedef struct {
     const char* short_cut_key;
     const char* description;
-    char key;
+    uint8_t key;
     CommandAction(*action)(void) MYCC;
 } Command;
 
 CommandAction sheet_save(void) MYCC;
+CommandAction sheet_quick_save(void) MYCC;
+CommandAction sheet_import(void) MYCC;
+CommandAction sheet_export(void) MYCC;
 CommandAction sheet_goto(void) MYCC;
 CommandAction sheet_quit(void) MYCC;
+#ifdef PROFILE
+CommandAction sheet_profile(void) MYCC;
+CommandAction sheet_bench(void) MYCC;
+#endif
 
 Command commands[] = {
     {"^S", "Save", KEY_SAVE, sheet_save},
+    {"^J", "Journal", KEY_QUICKSAVE, sheet_quick_save},
+    {"^I", "Import", KEY_IMPORT, sheet_import},
+    {"^E", "Export", KEY_EXPORT, sheet_export},
     {"^G", "Goto", KEY_GOTO, sheet_goto},
     {"^Q", "Quit", KEY_QUIT, sheet_quit},
+#ifdef PROFILE
+    {"^P", "Profile", KEY_PROFILE, sheet_profile},
+    {"^B", "Bench", KEY_BENCH, sheet_bench},
+#endif
     {NULL, NULL, 0, NULL}
 };
 
@@ -1328,9 +165,30 @@ CommandAction confirm(const char *prompt) MYCC {
 }
 
 void clrcell(void) {
-    for (uint8_t i = 0; i < CELL_W; i++) {
-        putch(' ');
+    tile_field(CELL_W, "");
+}
+
+/* Render the cached value into the cell's display string */
+void format_cell(Cell* c) MYCC {
+    Value v = c->cached;
+    if (v.type == TYPE_NUM) {
+        fmt_num(c->disp, v.num, CELL_W);
+        return;
+    }
+
+    if (v.type == TYPE_ERROR) {
+        sprintf(ln, "%*s", CELL_W, "<error>");
     }
+    else if (v.str) {
+        int skip_first = 0;
+        if (*v.str == '\'') skip_first = 1;
+        snprintf(ln, sizeof(ln), "%*s", CELL_W, v.str+skip_first);
+    }
+    else {
+        sprintf(ln, "%*s", CELL_W, "");
+    }
+    ln[CELL_W] = 0; // truncate to fit
+    strcpy(c->disp, ln);
 }
 
 void print_cell(int col, int row) MYCC {
@@ -1346,28 +204,16 @@ void print_cell(int col, int row) MYCC {
     }
     Cell* c = find_cell(col, row);
     if (c && c->content) {
-        Value v = c->cached;
-        if (v.type == TYPE_ERROR) {
-            print("%*s", CELL_W, "<error>");
-            if (col == ccol && row == crow) {
-                error("Error: %s", v.str);
-            }
+        if (c->cached.type == TYPE_ERROR && col == ccol && row == crow) {
+            error("Error: %s", c->cached.str);
         }
-        else if (v.type == TYPE_NUM) {
-            int i = sprintf(ln, "%*g", CELL_W, v.num);
-            if (i > CELL_W) {
-                sprintf(ln, "%*.5g", CELL_W, v.num);
-            }
-            prints(ln);
+        if (!c->disp) {
+            c->disp = malloc(CELL_W + 1);
+            if (c->disp) *c->disp = 0;
         }
-        else if (v.str) {
-            int skip_first = 0;
-            if (*v.str == '\'') skip_first = 1;
-            int i = sprintf(ln, "%*s", CELL_W, v.str+skip_first);
-            if (i >= CELL_W) {
-                ln[CELL_W] = 0; // truncate to fit
-            }
-            prints(ln);         
+        if (c->disp) {
+            if (!*c->disp) format_cell(c);
+            tile_puts(c->disp);
         }
         else
             clrcell();
@@ -1416,74 +262,74 @@ const char* get_filename(const char* path) MYCC {
     return p;
 }
 
-int do_save(void) MYCC {
-    status("Saving...");
-    strcpy(tmpbuffer, e_filename);
-    strcat(tmpbuffer, ".tmp");
+void save_report(int err) MYCC {
+    if (err) {
+        is_dirty = 1;
+        error("Error saving file: %s", strerror(err));
+    }
+    else {
+        status("");
+    }
+    sheet_update_filename();
+}
 
+/* Write the next slice of a background save, called while no key is waiting */
+void save_idle(void) MYCC {
     errno = 0;
-    void* f = create_file(tmpbuffer);
-    if (errno) return errno;
-
-    for (int i = 0; i < CELL_TBL_SIZE; i++) {
-        HNode* node = hash_table[i];
-        while (node) {
-            Cell* c = node->cell;
-            if (c->content && *c->content) {
-                sprintf(ln, "%c%d:%s\r\n", 'A' + c->col, c->row + 1, c->content);
-                write_file(f, ln, strlen(ln));
-                if (errno) {
-                    close_file(f);
-                    return errno;
-                }
-            }
-            node = node->next;
-        }
+    if (!save_step(SAVE_STEP)) {
+        show_progress("Saving...", (uint8_t)(save_row * 100 / save_rows));
+        return;
     }
-    close_file(f);
+    save_report(save_end());
+}
+
+/* Complete a background save in the foreground, returns errno */
+int save_finish(void) MYCC {
+    if (!save_file) return 0;
+    status("Saving...");
+    errno = 0;
+    while (!save_step(UINT16_MAX));
+    int err = save_end();
+    save_report(err);
+    return err;
+}
+
+/* Set a cell from the keyboard, recording it for the next quick save */
+void edit_cell(int c, int r, const char* s) MYCC {
+    if (!save_protect(c, r)) save_finish();
+    set_cell(c, r, s);
+    journal_note(find_cell(c, r));
+}
+
+/* Load the next slice of a background load, called while no key is waiting */
+void load_step(void) MYCC {
+    if (load_more(LOAD_STEP)) {
+        show_progress("Loading...", load_progress());
+        return;
+    }
+    load_end();
+    redraw = REDRAW_ALL;
+    status("");
+}
 
-    rename_file(tmpbuffer, filename);
-    return errno;
+/* Complete a background load before anything that needs the whole sheet */
+void load_finish(void) MYCC {
+    if (!load_file) return;
+    status("Loading...");
+    while (load_more(UINT16_MAX));
+    load_end();
+    redraw = REDRAW_ALL;
+    status("");
 }
 
 void do_load(const char* filepath) MYCC {
     status("Loading...");
-    errno = 0;
-    void* f = open_file(filepath);
-    
-    if (!errno) {
-        int bytes = read_file(f, tmpbuffer, sizeof(tmpbuffer));
-        int pos = 0;
-        while (bytes > 0) {
-            for (int i = 0; i < bytes; i++) {
-                if (tmpbuffer[i] == '\n') continue;
-                if (tmpbuffer[i] == '\r') {
-                    if (pos > 0) {
-                        ln[pos] = 0; // terminate line
-                        pos = 0; // reset position for next line
-                        char* p = ln;
-                        char col_ref;
-                        int col = -1, row = -1;
-                        char* content = NULL;
-                        if (sscanf(p, "%c%d:%s", &col_ref, &row, ln) == 3) {
-                            col = col_ref - 'A'; // convert to zero-based index
-                            row--;               // convert to zero-based index
-                            if (col >= 0 && col < MAX_COLS && row >= 0 && row < MAX_ROWS) {
-                                set_cell(col, row, ln);
-                            }
-                        }
-                    }
-                }
-                else if (pos < sizeof(ln) - 1) // prevent overflow
-                    ln[pos++] = tmpbuffer[i];
-            }
-            bytes = read_file(f, tmpbuffer, sizeof(tmpbuffer));
-        }
-        close_file(f);
-    }
-    is_dirty = 0; // clear dirty flag
     strcpy(filename, filepath);
     e_filename = &filename[0];
+
+    // the rest of a long text file loads while waiting for keys
+    if (!load_open(filepath, view_r + VIEW_ROWS)) load_end();
+    redraw = REDRAW_ALL;
 }
 
 CommandAction sheet_save(void) MYCC {
@@ -1494,7 +340,8 @@ CommandAction sheet_save(void) MYCC {
         return COMMAND_ACTION_CANCEL;
 
     e_filename = &filename[0];
-    int status = do_save();
+    // text files are written from the idle loop, edits from here on set the dirty flag again
+    int status = is_binary_file(e_filename) ? do_save() : save_begin();
     if (status) {
         error("Error saving file: %s", strerror(status));
         return COMMAND_ACTION_FAILED;
@@ -1505,6 +352,170 @@ CommandAction sheet_save(void) MYCC {
     return COMMAND_ACTION_NONE;    
 }
 
+/* Append the edits to the journal, compacting into a full save when it grows too long */
+CommandAction sheet_quick_save(void) MYCC {
+    if (!e_filename || !*e_filename) return sheet_save();
+
+    int err;
+    if (journal_overflow || journal_records + journal_count > MAX_JOURNAL_RECORDS) {
+        err = do_save();
+    }
+    else {
+        status("Saving journal...");
+        err = journal_save();
+    }
+    if (err) {
+        error("Error saving file: %s", strerror(err));
+        return COMMAND_ACTION_FAILED;
+    }
+
+    is_dirty = 0; // clear dirty flag
+    sheet_update_filename();
+    return COMMAND_ACTION_NONE;
+}
+
+/* Read a CSV file into the sheet with its first value at the cursor */
+CommandAction sheet_import(void) MYCC {
+    set_cursor_pos(0, INPUT_LINE_ROW);
+    *tmpbuffer = 0;
+    if (!edit_line("Import CSV", NULL, tmpbuffer, 250))
+        return COMMAND_ACTION_CANCEL;
+
+    void* f = open_file(tmpbuffer);
+    if (errno) {
+        error("Error opening file: %s", strerror(errno));
+        return COMMAND_ACTION_FAILED;
+    }
+
+    status("Importing...");
+    in_open(f);
+    batch_begin();
+    char field[80];
+    uint8_t len = 0, quoted = 0, in_record = 0, over = 0;
+    uint16_t cut = 0;   // values longer than field
+    int col = ccol, row = crow;
+    for (;;) {
+        int ch = in_getc();
+        if (quoted) {
+            if (ch != '"') {
+                if (ch >= 0) {
+                    if (len < sizeof(field) - 1) field[len++] = ch;
+                    else over = 1;
+                    continue;
+                }
+            }
+            else if ((ch = in_getc()) == '"') {
+                if (len < sizeof(field) - 1) field[len++] = ch;
+                else over = 1;
+                continue;
+            }
+            quoted = 0; // closing quote, ch is the character after it
+        }
+        if (ch == '"' && !len) {
+            quoted = in_record = 1;
+            continue;
+        }
+        if (ch == ',' || ch == '\r' || ch == '\n' || ch < 0) {
+            if (ch == ',') in_record = 1;
+            if (in_record) {
+                field[len] = 0;
+                if (len && col < MAX_COLS && row < MAX_ROWS) set_cell(col, row, field);
+                cut += over;
+                len = over = 0;
+                ++col;
+            }
+            if (ch < 0) break;
+            if (ch != ',' && in_record) {
+                // blank lines, including the '\n' of "\r\n", are skipped
+                in_record = 0;
+                col = ccol;
+                ++row;
+            }
+            continue;
+        }
+        in_record = 1;
+        if (len < sizeof(field) - 1) field[len++] = ch;
+        else over = 1;
+    }
+    batch_commit();
+    in_close();
+    close_file(f);
+    if (cut) error("%d values cut to %d characters", cut, (int)(sizeof(field) - 1));
+
+    journal_overflow = 1; // too many cells for the journal, the next quick save is a full save
+    redraw = REDRAW_CONTENT;
+    sheet_update_filename();
+    return COMMAND_ACTION_NONE;
+}
+
+void out_csv_value(const Value* v) MYCC {
+    if (v->type == TYPE_NUM) {
+        char buf[16];
+        uint8_t n = fmt_num(buf, v->num, sizeof(buf) - 1);
+        out_write(buf + sizeof(buf) - 1 - n, n);
+        return;
+    }
+    if (v->type == TYPE_NULL || !v->str) return;
+
+    const char* s = v->str;
+    if (!strpbrk(s, ",\"\r\n")) {
+        out_write(s, strlen(s));
+        return;
+    }
+    out_putc('"');
+    for (; *s; ++s) {
+        if (*s == '"') out_putc('"');
+        out_putc(*s);
+    }
+    out_putc('"');
+}
+
+/* Write the calculated values of the used part of the sheet as CSV */
+CommandAction sheet_export(void) MYCC {
+    set_cursor_pos(0, INPUT_LINE_ROW);
+    *tmpbuffer = 0;
+    if (!edit_line("Export CSV", NULL, tmpbuffer, 250))
+        return COMMAND_ACTION_CANCEL;
+
+    void* f = create_file(tmpbuffer);
+    if (errno) {
+        error("Error saving file: %s", strerror(errno));
+        return COMMAND_ACTION_FAILED;
+    }
+
+    status("Exporting...");
+    uint32_t cols = 0;
+    int rows = 0;
+    for (int r = 0; r < MAX_ROWS; r++) {
+        if (row_occ[r]) {
+            cols |= row_occ[r];
+            rows = r + 1;
+        }
+    }
+
+    out_open(f);
+    for (int r = 0; r < rows; r++) {
+        uint32_t bits = cols;
+        for (int c = 0; bits; c++, bits >>= 1) {
+            if ((row_occ[r] >> c) & 1) {
+                Cell* cell = find_cell(c, r);
+                if (cell) out_csv_value(&cell->cached);
+            }
+            if (bits > 1) out_putc(',');
+        }
+        out_write("\r\n", 2);
+    }
+    out_flush();
+    close_file(f);
+    if (errno) {
+        error("Error saving file: %s", strerror(errno));
+        return COMMAND_ACTION_FAILED;
+    }
+
+    sheet_update_filename();
+    return COMMAND_ACTION_NONE;
+}
+
 CommandAction sheet_goto(void) MYCC {
     char input[5] = { 0 };
     set_cursor_pos(0, INPUT_LINE_ROW);
@@ -1530,7 +541,7 @@ CommandAction sheet_quit(void) MYCC {
         CommandAction action = confirm("File modified. Save?");
         switch (action) {
             case COMMAND_ACTION_YES:
-                if (sheet_save() != COMMAND_ACTION_NONE) {
+                if (sheet_save() != COMMAND_ACTION_NONE || save_finish()) {
                     return COMMAND_ACTION_NONE;
                 }
                 break;
@@ -1546,32 +557,112 @@ CommandAction sheet_quit(void) MYCC {
     return COMMAND_ACTION_NONE;
 }
 
+#ifdef PROFILE
+/* Show where the previous keystroke spent its time */
+CommandAction sheet_profile(void) MYCC {
+    char* p = tmpbuffer;
+    p += sprintf(p, "Last key:");
+    for (uint8_t i = 0; i < PROF_COUNT; ++i) {
+        p += sprintf(p, " %s %gms", prof_names[i], (float)prof_last(i) / PROF_CYCLES_PER_MS);
+    }
+    status("%s", tmpbuffer);
+    getch();
+    return COMMAND_ACTION_NONE;
+}
+
+#define BENCH_ROUNDS 16
+
+/* Cycles per cell for the old sprintf cell formatting against fmt_num,
+   then cycles for a full screen flip with memcpy against the DMA */
+CommandAction sheet_bench(void) MYCC {
+    static const float samples[] = { 0, 7, -42, 3.14159f, 1234567, 0.000123f, -98765.43f, 1.5e20f };
+    uint32_t cycles[2];
+
+    status("Benchmarking...");
+    for (uint8_t pass = 0; pass < 2; ++pass) {
+        prof_mark();
+        for (uint8_t r = 0; r < BENCH_ROUNDS; ++r) {
+            for (uint8_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+                if (pass) {
+                    fmt_num(ln, samples[i], CELL_W);
+                }
+                else if (sprintf(ln, "%*g", CELL_W, samples[i]) > CELL_W) {
+                    sprintf(ln, "%*.5g", CELL_W, samples[i]);
+                }
+            }
+        }
+        cycles[pass] = prof_since_mark() / (BENCH_ROUNDS * (sizeof(samples) / sizeof(samples[0])));
+    }
+    status("Cycles per cell: sprintf %g, fmt_num %g", (float)cycles[0], (float)cycles[1]);
+    getch();
+
+    for (uint8_t pass = 0; pass < 2; ++pass) {
+        prof_mark();
+        flip_all(pass);
+        cycles[pass] = prof_since_mark();
+    }
+    status("Cycles per flip: memcpy %g, DMA %g", (float)cycles[0], (float)cycles[1]);
+    getch();
+    return COMMAND_ACTION_NONE;
+}
+#endif //PROFILE
+
 void print_col_headers(void) {
+    char hdr[CELL_W + 2];
+    memset(hdr, ' ', CELL_W);
+    hdr[CELL_W] = '|';
+    hdr[CELL_W + 1] = 0;
+
     highlight();
     set_cursor_pos(0, 0);
-    prints("    "); 
+    tile_field(4, "");
     for (int cc = 0; cc < VIEW_COLS; cc++) {
-        char hdr = 'A' + view_c + cc;
-        print(" %*c %*c", CELL_W / 2, hdr, (int)(CELL_W / 2.0f + 0.5) - 1, '|');
+        hdr[CELL_W / 2] = 'A' + view_c + cc;
+        tile_puts(hdr);
     }
-    prints("    ");
+    tile_field(4, "");
     standard();
 }
 
-void print_row_headers(void) {
+void print_row_header(int rr) {
+    char hdr[4];
+    int n = view_r + rr + 1;
+    hdr[0] = n >= 100 ? '0' + n / 100 : ' ';
+    hdr[1] = n >= 10 ? '0' + n / 10 % 10 : ' ';
+    hdr[2] = '0' + n % 10;
+    hdr[3] = 0;
+
     highlight();
+    set_cursor_pos(0, rr + 1);
+    tile_puts(hdr);
+    standard();
+}
+
+void print_row_headers(void) {
     for (int rr = 0; rr < VIEW_ROWS; rr++) {
-        set_cursor_pos(0, rr + 1);
-        int realr = view_r + rr;
-        print("%3d", realr + 1);                
+        print_row_header(rr);
     }
-    standard();
 }
 
+/* Newly exposed row after a scroll, header included */
+void print_view_row(int rr) {
+    print_row_header(rr);
+    for (int cc = 0; cc < VIEW_COLS; cc++) {
+        print_cell(view_c + cc, view_r + rr);
+    }
+}
+
+void print_view_col(int cc) {
+    for (int rr = 0; rr < VIEW_ROWS; rr++) {
+        print_cell(view_c + cc, view_r + rr);
+    }
+}
 
 /* Print viewport */
 void print_view(void) {
-    has_error = 0; // reset error flag
+    static int prev_col = 0, prev_row = 0;
+
+    PROF_BEGIN(PROF_RENDER);
     set_cursor_pos(0, 0);
 
     if (redraw == REDRAW_ALL) {
@@ -1580,19 +671,65 @@ void print_view(void) {
         redraw = REDRAW_CONTENT;
     }
 
-    for (int rr = 0; rr < VIEW_ROWS; rr++) {
-        set_cursor_pos(3, rr + 1);
-        int realr = view_r + rr;
-        for (int cc = 0; cc < VIEW_COLS; cc++) {
-            int realc = view_c + cc;
-            print_cell(realc, realr);
+    // Shift what is already on screen and paint only the exposed row or column
+    switch (redraw) {
+        case REDRAW_SCROLL_UP:
+            move_rows(2, 1, VIEW_ROWS - 1);
+            print_view_row(0);
+            break;
+        case REDRAW_SCROLL_DOWN:
+            move_rows(1, 2, VIEW_ROWS - 1);
+            print_view_row(VIEW_ROWS - 1);
+            break;
+        case REDRAW_SCROLL_LEFT:
+            move_cols(4 + CELL_W + 1, 4, (VIEW_COLS - 1) * (CELL_W + 1), 1, VIEW_ROWS);
+            print_col_headers();
+            print_view_col(0);
+            break;
+        case REDRAW_SCROLL_RIGHT:
+            move_cols(4, 4 + CELL_W + 1, (VIEW_COLS - 1) * (CELL_W + 1), 1, VIEW_ROWS);
+            print_col_headers();
+            print_view_col(VIEW_COLS - 1);
+            break;
+    }
+
+    if (redraw == REDRAW_CONTENT) {
+        for (int rr = 0; rr < VIEW_ROWS; rr++) {
+            set_cursor_pos(3, rr + 1);
+            int realr = view_r + rr;
+            for (int cc = 0; cc < VIEW_COLS; cc++) {
+                int realc = view_c + cc;
+                print_cell(realc, realr);
+            }
+        }
+    }
+    else {
+        // Only cells that changed value or highlight
+        for (uint8_t i = 0; i < changed_count; ++i) {
+            Cell* c = changed[i];
+            if (in_view(c->col, c->row)) print_cell(c->col, c->row);
         }
+        if ((prev_col != ccol || prev_row != crow) && in_view(prev_col, prev_row)) {
+            print_cell(prev_col, prev_row);
+        }
+        print_cell(ccol, crow);
     }
+
+    for (uint8_t i = 0; i < changed_count; ++i) {
+        changed[i]->flags &= MSK_CHANGED;
+    }
+    changed_count = 0;
+    redraw = REDRAW_CHANGED;
+    prev_col = ccol;
+    prev_row = crow;
     
+    // an error from the last command or this repaint stays until the next one
     if (!has_error) {
         set_cursor_pos(0, STATUS_LINE_ROW);
         clreol();
+        shown_progress = 0xff;
     }
+    has_error = 0;
     
     if (is_dirty != was_dirty) {
         was_dirty = is_dirty;
@@ -1608,13 +745,20 @@ void print_view(void) {
     }
     standard();
     clreol();
+    PROF_END(PROF_RENDER);
+    REPLAY_END();
+}
+
+/* One step scrolls can reuse the screen, anything else repaints it all */
+void scroll_view(REDRAW_MODE mode) {
+    redraw = redraw == REDRAW_CHANGED ? mode : REDRAW_ALL;
 }
 
 void move_left(void) {
     if (ccol > 0) ccol--;
     if (ccol < view_c) {
         view_c--;
-        redraw = REDRAW_ALL;
+        scroll_view(REDRAW_SCROLL_LEFT);
     }
 }
 
@@ -1622,7 +766,7 @@ void move_right(void) {
     if (ccol < MAX_COLS - 1) ccol++;
     if (ccol >= view_c + VIEW_COLS) {
         view_c++;
-        redraw = REDRAW_ALL;
+        scroll_view(REDRAW_SCROLL_RIGHT);
     }
 }
 
@@ -1630,7 +774,7 @@ void move_up(void) {
     if (crow > 0) crow--;
     if (crow < view_r) {
         view_r--;
-        redraw = REDRAW_ALL;
+        scroll_view(REDRAW_SCROLL_UP);
     }
 }
 
@@ -1638,25 +782,140 @@ void move_down(void) {
     if (crow < MAX_ROWS - 1) crow++;
     if (crow >= view_r + VIEW_ROWS) {
         view_r++; 
-        redraw = REDRAW_ALL;
+        scroll_view(REDRAW_SCROLL_DOWN);
     }
 }
 
+void page_up(void) {
+    int old_r = view_r;
+    crow = crow < VIEW_ROWS ? 0 : crow - VIEW_ROWS;
+    view_r = view_r < VIEW_ROWS ? 0 : view_r - VIEW_ROWS;
+    if (view_r != old_r) redraw = REDRAW_ALL;
+}
+
+void page_down(void) {
+    int old_r = view_r;
+    crow = crow + VIEW_ROWS > MAX_ROWS - 1 ? MAX_ROWS - 1 : crow + VIEW_ROWS;
+    view_r = view_r + VIEW_ROWS > MAX_ROWS - VIEW_ROWS ? MAX_ROWS - VIEW_ROWS : view_r + VIEW_ROWS;
+    if (view_r != old_r) redraw = REDRAW_ALL;
+}
 
-int main(int argc, char* argv[]) {
-    errInvalidArg.str = "Invalid argument";
-    errExprInvalid.str = "Invalid expression";
-    errExprDivZero.str = "Division by zero";
-    errExprCyclicRef.str = "Cyclic reference";
-    errExprExpectLParen.str = "Expected '('";
-    errExprExpectRParen.str = "Expected ')'";
-    errExprExpectNumeric.str = "Expected numeric value";
-    errOutOfMemory.str = "Out of memory";
+/* Bring the cursor column into view after a jump, one repaint at most */
+void show_col(void) {
+    int old_c = view_c;
+    if (ccol < view_c) view_c = ccol;
+    else if (ccol >= view_c + VIEW_COLS) view_c = ccol - VIEW_COLS + 1;
+    if (view_c != old_c) redraw = REDRAW_ALL;
+}
+
+/* Jump to the next data edge in the row, like Ctrl+arrow: the end of the
+   block the cursor is in, otherwise the start of the next block */
+void jump_right(void) {
+    uint32_t bits = row_occ[crow];
+    uint32_t m = 1UL << ccol;
+    if (ccol >= MAX_COLS - 1) return;
+    if ((bits & m) && (bits & (m << 1))) {
+        while (ccol < MAX_COLS - 1 && (bits & (m << 1))) { ++ccol; m <<= 1; }
+    }
+    else if (bits >> (ccol + 1)) {
+        do { ++ccol; m <<= 1; } while (!(bits & m));
+    }
+    else {
+        ccol = MAX_COLS - 1;
+    }
+    show_col();
+}
+
+void jump_left(void) {
+    uint32_t bits = row_occ[crow];
+    uint32_t m = 1UL << ccol;
+    if (ccol == 0) return;
+    if ((bits & m) && (bits & (m >> 1))) {
+        while (ccol > 0 && (bits & (m >> 1))) { --ccol; m >>= 1; }
+    }
+    else if (bits & (m - 1)) {
+        do { --ccol; m >>= 1; } while (!(bits & m));
+    }
+    else {
+        ccol = 0;
+    }
+    show_col();
+}
+
+/* Bring the cursor row into view after a jump, one repaint at most */
+void show_row(void) {
+    int old_r = view_r;
+    if (crow < view_r) view_r = crow;
+    else if (crow >= view_r + VIEW_ROWS) view_r = crow - VIEW_ROWS + 1;
+    if (view_r != old_r) redraw = REDRAW_ALL;
+}
+
+uint8_t is_used(uint8_t* col, int r) {
+    return (col[r >> 3] >> (r & 7)) & 1;
+}
+
+/* Jump to the next data edge in the column, as jump_right does in the row.
+   Empty stretches are skipped a byte, eight rows, at a time. */
+void jump_down(void) {
+    uint8_t* col = col_occ[ccol];
+    int r = crow + 1;
+    if (crow >= MAX_ROWS - 1) return;
+    if (is_used(col, crow) && is_used(col, r)) {
+        while (r < MAX_ROWS - 1 && is_used(col, r + 1)) ++r;
+    }
+    else {
+        while (r < MAX_ROWS && !is_used(col, r)) {
+            if (!(r & 7) && !col[r >> 3]) r += 8;
+            else ++r;
+        }
+        if (r == MAX_ROWS) r = MAX_ROWS - 1;
+    }
+    crow = r;
+    show_row();
+}
 
+void jump_up(void) {
+    uint8_t* col = col_occ[ccol];
+    int r = crow - 1;
+    if (crow == 0) return;
+    if (is_used(col, crow) && is_used(col, r)) {
+        while (r > 0 && is_used(col, r - 1)) --r;
+    }
+    else {
+        while (r >= 0 && !is_used(col, r)) {
+            if ((r & 7) == 7 && !col[r >> 3]) r -= 8;
+            else --r;
+        }
+        if (r < 0) r = 0;
+    }
+    crow = r;
+    show_row();
+}
+
+uint8_t is_nav_key(uint8_t ch) MYCC {
+    switch (ch) {
+        case KEY_LEFT: case KEY_RIGHT: case KEY_UP: case KEY_DOWN:
+        case KEY_PAGEUP: case KEY_PAGEDOWN: case KEY_WORDLEFT: case KEY_WORDRIGHT:
+        case KEY_JUMPUP: case KEY_JUMPDOWN:
+            return 1;
+    }
+    return 0;
+}
+
+#ifndef TICKS
+int main(int argc, char* argv[]) {
+    engine_init();
     init();
     screen_init();
 
     print_view();
+#ifdef REPLAY
+    if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+        if (!replay_open(argv[2])) error(errOutOfMemory.str);
+        argc -= 2;
+        argv += 2;
+    }
+#endif
     if (argc > 1) {
         do_load(get_lfn(argv[1]));
     }
@@ -1667,15 +926,35 @@ int main(int argc, char* argv[]) {
     sheet_show_hotkeys();
     sheet_update_filename();
     
+    uint8_t idle = 0;   // the last pass ran a background slice
     for (;;) {
-        print_view();
-        char ch = getch();
+        // a slice seldom changes what is in view, only repaint if it did
+        if (!idle || redraw != REDRAW_CHANGED || changed_count) print_view();
+        idle = 1;
+        if (load_file && !kbhit()) {
+            load_step();
+            continue;
+        }
+        if (save_file && !kbhit()) {
+            save_idle();
+            continue;
+        }
+        idle = 0;
+        uint8_t ch = getch(); // key codes above 127 are commands
+        PROF_KEYSTROKE();
+        if (load_file && !is_nav_key(ch)) load_finish(); // edits and commands need the whole sheet
         switch (ch) {
-            case KEY_BACKSPACE: set_cell(ccol, crow, NULL); break;
+            case KEY_BACKSPACE: edit_cell(ccol, crow, NULL); break;
             case KEY_LEFT:move_left(); break;
             case KEY_RIGHT:move_right(); break;
             case KEY_UP: move_up(); break;
             case KEY_DOWN: move_down(); break;
+            case KEY_PAGEUP: page_up(); break;
+            case KEY_PAGEDOWN: page_down(); break;
+            case KEY_WORDLEFT: jump_left(); break;
+            case KEY_WORDRIGHT: jump_right(); break;
+            case KEY_JUMPUP: jump_up(); break;
+            case KEY_JUMPDOWN: jump_down(); break;
             default:
                 if (ch == KEY_ENTER || ch == KEY_ESC || (ch > 31 && ch < 128)) {
                     Cell* c = find_cell(ccol, crow);
@@ -1695,11 +974,12 @@ int main(int argc, char* argv[]) {
                     char prompt[8];
                     sprintf(prompt, "%c%d", 'A' + ccol, crow + 1);
                     if (edit_line(prompt, NULL, ln, sizeof(ln) - 8)) {
-                        set_cell(ccol, crow, ln);
+                        edit_cell(ccol, crow, ln);
                         move_down();
                     }
                 }
                 else {
+                    save_finish(); // commands may need the file or the output stream
                     for (Command* cmd = (Command*)commands; cmd->short_cut_key != NULL; ++cmd) {
                         if (ch == cmd->key) {
                             standard();
@@ -1707,6 +987,9 @@ int main(int argc, char* argv[]) {
                                 CommandAction action = cmd->action();
                                 switch (action) {
                                     case COMMAND_ACTION_QUIT:
+#ifdef REPLAY
+                                        replay_close();
+#endif
 #ifdef MEMDBG
                                         free_cells();
                                         _CrtDumpMemoryLeaks();
@@ -1723,4 +1006,5 @@ int main(int argc, char* argv[]) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif //TICKS
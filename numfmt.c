@@ -0,0 +1,222 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "platform.h"
+#include "numfmt.h"
+
+#define MAX_SIG_DIGITS  6
+#define MAX_EXACT_INT   10000000.0f // 10^7, floats are exact integers below 2^24
+#define MAX_FLOAT       3.4028234e38f
+
+static const uint32_t pow10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// 10^(3i) for i from POW1000_MIN as a 64-bit mantissa (hi, lo) times 2^exp,
+// rounded up, covering the scales split needs for any float
+typedef struct {
+    uint32_t hi, lo;
+    int16_t exp;
+} Pow10;
+
+#define POW1000_MIN     (-10)
+
+static const Pow10 pow1000[] = {
+    { 0xa2425ff7, 0x5e14fc32, -163 },   // 10^-30
+    { 0x9e74d1b7, 0x91e07e49, -153 },   // 10^-27
+    { 0x9abe14cd, 0x44753b53, -143 },   // 10^-24
+    { 0x971da050, 0x74da7bef, -133 },   // 10^-21
+    { 0x9392ee8e, 0x921d5d08, -123 },   // 10^-18
+    { 0x901d7cf7, 0x3ab0acda, -113 },   // 10^-15
+    { 0x8cbccc09, 0x6f5088cc, -103 },   // 10^-12
+    { 0x89705f41, 0x36b4a598,  -93 },   // 10^-9
+    { 0x8637bd05, 0xaf6c69b6,  -83 },   // 10^-6
+    { 0x83126e97, 0x8d4fdf3c,  -73 },   // 10^-3
+    { 0x80000000, 0x00000000,  -63 },   // 10^0
+    { 0xfa000000, 0x00000000,  -54 },   // 10^3
+    { 0xf4240000, 0x00000000,  -44 },   // 10^6
+    { 0xee6b2800, 0x00000000,  -34 },   // 10^9
+    { 0xe8d4a510, 0x00000000,  -24 },   // 10^12
+    { 0xe35fa931, 0xa0000000,  -14 },   // 10^15
+    { 0xde0b6b3a, 0x76400000,   -4 },   // 10^18
+    { 0xd8d726b7, 0x177a8000,    6 },   // 10^21
+    { 0xd3c21bce, 0xcceda100,   16 },   // 10^24
+    { 0xcecb8f27, 0xf4200f3a,   26 },   // 10^27
+    { 0xc9f2c9cd, 0x04674edf,   36 },   // 10^30
+    { 0xc5371912, 0x364ce306,   46 },   // 10^33
+    { 0xc097ce7b, 0xc90715b4,   56 },   // 10^36
+    { 0xbc143fa4, 0xe250eb32,   66 },   // 10^39
+    { 0xb7abc627, 0x050305ae,   76 },   // 10^42
+    { 0xb35dbf82, 0x1ae4f38c,   86 },   // 10^45
+    { 0xaf298d05, 0x0e4395d7,   96 },   // 10^48
+    { 0xab0e93b6, 0xefee0054,  106 },   // 10^51
+};
+
+static char text[16];   // unpadded result, built left to right
+
+static char* put_uint(char* p, uint32_t n) {
+    char digits[10];
+    uint8_t i = 0;
+    do {
+        digits[i++] = '0' + (uint8_t)(n % 10);
+        n /= 10;
+    } while (n);
+    while (i) *p++ = digits[--i];
+    return p;
+}
+
+static uint32_t sig;     // the value as 9 or 10 digits, truncated
+static uint8_t sig_len;
+static int8_t sig_exp;   // decimal exponent of its leading digit
+
+// a * b as 64 bits, returns the high half and stores the low half in lo
+static uint32_t mul_wide(uint32_t a, uint32_t b, uint32_t* lo) {
+    uint16_t al = a, ah = a >> 16, bl = b, bh = b >> 16;
+    uint32_t ll = (uint32_t)al * bl;
+    uint32_t mid = (uint32_t)al * bh;
+    uint32_t hl = (uint32_t)ah * bl;
+    uint32_t hi = (uint32_t)ah * bh;
+    mid += hl;
+    if (mid < hl) hi += 0x10000UL;
+    *lo = ll + (mid << 16);
+    if (*lo < ll) ++hi;
+    return hi + (mid >> 16);
+}
+
+/* Split v (> 0) into sig and sig_exp, once for every precision tried.
+   v is exactly m * 2^b, and m * 10^s for s picked from the binary exponent
+   lies in [10^8, 2 * 10^9). The mantissa of 10^s is good to 64 bits, so
+   sig is the exact truncation but for values within 2^-31 of an integer. */
+static void split(float v) {
+    union { float f; uint32_t u; } bits;
+    bits.f = v;
+    uint8_t be = (bits.u >> 23) & 0xff;
+    uint32_t m = bits.u & 0x7fffff;
+    int16_t b = -149;
+    if (be) {
+        m |= 0x800000;
+        b = be - 150;
+    }
+    while (!(m & 0x800000)) {
+        m <<= 1;
+        --b;
+    }
+
+    // 10^e0 <= 2^t <= v < 2^(t+1) < 2 * 10^(e0+1)
+    int16_t t = b + 23;
+    int8_t e0 = ((int32_t)t * 1233) >> 12;  // floor(t * log10(2))
+    int8_t s = 8 - e0;
+    int8_t i = s >= 0 ? s / 3 : -((2 - s) / 3);
+    m *= pow10[s - i * 3];                  // below 2^31
+    const Pow10* p = &pow1000[i - POW1000_MIN];
+
+    uint32_t lo, mid, below;
+    uint32_t hi = mul_wide(m, p->hi, &lo);
+    mid = mul_wide(m, p->lo, &below);       // below is far below the point
+    lo += mid;
+    if (lo < mid) ++hi;
+
+    // (hi, lo) * 2^(32 + exp + b) is v * 10^s
+    uint8_t shift = -(32 + p->exp + b);
+    sig = shift >= 32 ? hi >> (shift - 32) : (hi << (32 - shift)) | (lo >> shift);
+    sig_len = sig >= pow10[9] ? 10 : 9;
+    sig_exp = sig_len - 1 - s;
+}
+
+/* %g style formatting of the split value with prec significant digits */
+static char* put_sig(char* p, uint8_t prec) {
+    int8_t e = sig_exp;
+    char dig[MAX_SIG_DIGITS];
+
+    // sig is truncated, so its remainder alone decides the rounding
+    uint32_t div = pow10[sig_len - prec];
+    uint32_t d = sig / div;
+    if (sig % div >= div / 2) ++d;
+    if (d >= pow10[prec]) {     // 9.99.. rounded up to 10.0
+        d /= 10;
+        ++e;
+    }
+    for (uint8_t i = prec; i; --i) {
+        dig[i - 1] = '0' + (uint8_t)(d % 10);
+        d /= 10;
+    }
+    uint8_t nd = prec;
+    while (nd > 1 && dig[nd - 1] == '0') --nd;  // no trailing zeros
+
+    if (e < -4 || e >= prec) {
+        *p++ = dig[0];
+        if (nd > 1) {
+            *p++ = '.';
+            memcpy(p, &dig[1], nd - 1);
+            p += nd - 1;
+        }
+        *p++ = 'e';
+        *p++ = e < 0 ? '-' : '+';
+        if (e < 0) e = -e;
+        *p++ = '0' + e / 10;
+        *p++ = '0' + e % 10;
+    }
+    else if (e >= 0) {
+        for (uint8_t i = 0; i <= e; ++i) *p++ = i < nd ? dig[i] : '0';
+        if (nd > e + 1) {
+            *p++ = '.';
+            memcpy(p, &dig[e + 1], nd - e - 1);
+            p += nd - e - 1;
+        }
+    }
+    else {
+        *p++ = '0';
+        *p++ = '.';
+        for (int8_t i = e + 1; i; ++i) *p++ = '0';
+        memcpy(p, dig, nd);
+        p += nd;
+    }
+    return p;
+}
+
+uint8_t fmt_num(char* buf, float v, uint8_t width) MYCC {
+    char* p = text;
+    uint8_t len;
+
+    if (v != v) {
+        strcpy(p, "nan");
+        len = 3;
+    }
+    else {
+        if (v < 0) {
+            *p++ = '-';
+            v = -v;
+        }
+        if (v > MAX_FLOAT) {
+            memcpy(p, "inf", 3);
+            p += 3;
+        }
+        else if (v == 0) {
+            *p++ = '0';
+        }
+        else if (v < MAX_EXACT_INT && v == (float)(uint32_t)v) {
+            p = put_uint(p, (uint32_t)v);
+        }
+        else {
+            // Drop significant digits until it fits the field
+            char* s = p;
+            split(v);
+            for (uint8_t prec = MAX_SIG_DIGITS; prec; --prec) {
+                p = put_sig(s, prec);
+                if (p - text <= width) break;
+            }
+        }
+        len = p - text;
+    }
+
+    if (len > width) {
+        memset(buf, '#', width);
+        len = width;
+    }
+    else {
+        memset(buf, ' ', width - len);
+        memcpy(buf + width - len, text, len);
+    }
+    buf[width] = 0;
+    return len;
+}
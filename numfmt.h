@@ -0,0 +1,12 @@
+#ifndef NUMFMT_H_
+#define NUMFMT_H_
+
+#include <stdint.h>
+
+// Format v right-aligned into exactly width characters plus a terminator,
+// using as many significant digits (up to 6, like %g) as fit. Integers
+// below 10^7 are exact in a float and are written in full. Returns the
+// number of non-padding characters.
+uint8_t fmt_num(char* buf, float v, uint8_t width) MYCC;
+
+#endif //NUMFMT_H_
@@ -3,11 +3,13 @@
 #include <errno.h>
 #include <string.h>
 #include <z80.h>
+#include <intrinsic.h>
 #include <arch/zxn.h>
 #include <arch/zxn/esxdos.h>
 
 #include "platform.h"
 #include "crtio.h"
+#include "profile.h"
 
 uint8_t oldspeed;
 
@@ -16,9 +18,34 @@ struct esx_lfn lfn;
 char *filename = &lfn.filename[0];
 char tmpbuffer[256];
 
+#define REG_MMU3        0x53
+#define BLOCK_ADDR      0x6000  // MMU3, over the BASIC half of bank 5
+
+// block_map pages an allocated 8K page over 0x6000-0x7fff for the whole of
+// a load, from in_open to in_close, as the records are parsed in place.
+// Bank 5 is left as it was underneath and comes back on block_unmap. While
+// it is mapped nothing else uses that range: a dotn command has its code,
+// data, heap and stack at 0x2000-0x3fff and from 0x8000, the tilemap and
+// font end below 0x5800, and until the load is finished only load slices,
+// navigation and repaints run, none of which call into BASIC or the ROM.
+
+uint8_t block_page;     // 8K page mapped at MMU3 for reads, 0 if none could be allocated
+uint8_t block_mmu3;     // page restored by block_unmap
+
+// esxdos pages DivMMC memory over 0x2000-0x3fff, which may hold the
+// keyboard ISR, so interrupts are held off for the duration of a call
+#define IO_BEGIN()  do { intrinsic_di(); PROF_BEGIN(PROF_IO); } while (0)
+#define IO_END()    do { PROF_END(PROF_IO); intrinsic_ei(); } while (0)
+
 
 void cleanup(void) {
     screen_restore();
+    if (block_page) {
+        IO_BEGIN();
+        esx_ide_bank_free(ESX_BANKTYPE_RAM, block_page);
+        IO_END();
+    }
+    PROF_SHUTDOWN();
     ZXN_NEXTREGA(0x07, oldspeed);
 }
 
@@ -26,6 +53,14 @@ void init(void) {
     atexit(cleanup);
     oldspeed = ZXN_READ_REG(0x07) & 0x03;
     ZXN_NEXTREG(0x07, 3);
+    PROF_INIT();
+
+    errno = 0;
+    IO_BEGIN();
+    block_page = esx_ide_bank_alloc(ESX_BANKTYPE_RAM);
+    IO_END();
+    if (errno) block_page = 0;   // fall back to reading by sector
+    errno = 0;
 }
 
 const char* get_lfn(const char* filepath) {
@@ -34,9 +69,14 @@ const char* get_lfn(const char* filepath) {
     cat.filename = filename;
     cat.cat_sz = 2;
     
-    if (esx_dos_catalog(&cat) == 1) {
+    IO_BEGIN();
+    uint8_t found = esx_dos_catalog(&cat) == 1;
+    if (found) {
         lfn.cat = &cat;
         esx_ide_get_lfn(&lfn, &cat.cat[1]);
+    }
+    IO_END();
+    if (found) {
         char *p = filepath + strlen(filepath);
         while (p > filepath && *(p - 1) != '/' && *(p - 1) != '\\') --p;
         strcpy(p, filename);            
@@ -47,40 +87,97 @@ const char* get_lfn(const char* filepath) {
 
 void* open_file(const char* filename) {
     errno = 0;
+    IO_BEGIN();
     unsigned char f = esxdos_f_open(filename, ESXDOS_MODE_R | ESXDOS_MODE_OE);
+    IO_END();
     if (errno) return NULL;
     return (void*)f;
 }
 
 void* create_file(const char* filename) {
     errno = 0;
+    IO_BEGIN();
     unsigned char f = esxdos_f_open(filename, ESXDOS_MODE_W | ESXDOS_MODE_CT);
+    IO_END();
+    if (errno) return NULL;
+    return (void*)f;
+}
+
+void* append_file(const char* filename) {
+    struct esx_stat st;
+    errno = 0;
+    IO_BEGIN();
+    unsigned char f = esxdos_f_open(filename, ESXDOS_MODE_W | ESXDOS_MODE_OC);
+    if (!errno) {
+        esx_f_fstat(f, &st);
+        if (!errno) esx_f_seek(f, st.size, ESX_SEEK_SET);
+        if (errno) esxdos_f_close(f);
+    }
+    IO_END();
     if (errno) return NULL;
     return (void*)f;
 }
 
+uint32_t file_size(void* file) {
+    struct esx_stat st;
+    st.size = 0;
+    if (file) {
+        IO_BEGIN();
+        esx_f_fstat((unsigned char)file, &st);
+        IO_END();
+    }
+    return st.size;
+}
+
+void delete_file(const char* filename) {
+    IO_BEGIN();
+    esx_f_unlink(filename);
+    IO_END();
+}
+
 void close_file(void* file) {
     if (file) {
+        IO_BEGIN();
         esxdos_f_close((unsigned char)file);
+        IO_END();
     }
 }
 
 int read_file(void* file, char* buffer, size_t size) {
     if (file) {
-        return esxdos_f_read((unsigned char)file, buffer, size);
+        IO_BEGIN();
+        int bytes = esxdos_f_read((unsigned char)file, buffer, size);
+        IO_END();
+        return bytes;
     }
     return 0;
 }
 
 int write_file(void* file, const char* buffer, size_t size) {
     if (file) {
-        return esxdos_f_write((unsigned char)file, buffer, size);
+        IO_BEGIN();
+        int bytes = esxdos_f_write((unsigned char)file, buffer, size);
+        IO_END();
+        return bytes;
     }
     return 0;
 }
 
 void rename_file(const char* oldname, const char* newname) {
+    IO_BEGIN();
     esx_f_unlink(newname); // remove old file if exists
     errno = 0;
     esx_f_rename(oldname, newname);
-}
\ No newline at end of file
+    IO_END();
+}
+
+char* block_map(void) {
+    if (!block_page) return NULL;
+    block_mmu3 = ZXN_READ_REG(REG_MMU3);
+    ZXN_NEXTREGA(REG_MMU3, block_page);
+    return (char*)BLOCK_ADDR;
+}
+
+void block_unmap(void) {
+    if (block_page) ZXN_NEXTREGA(REG_MMU3, block_mmu3);
+}
@@ -1,8 +1,16 @@
 #ifndef PLATFORM_H__
 #define PLATFORM_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef HOST
 #include <z80.h>
 #include <arch/zxn.h>
+#else
+char* itoa(int num, char* buf, int radix); // z88dk's stdlib has it, the host's does not
+extern uint32_t write_calls;                // write_file calls so far, for make bench
+#endif
 
 #ifdef __SDCC
 #define MYCC __sdcccall(1)
@@ -17,11 +25,37 @@ const char* get_lfn(const char* filepath);
 
 void* open_file(const char* filename);
 void* create_file(const char* filename);
+void* append_file(const char* filename);
+void delete_file(const char* filename);
+uint32_t file_size(void* file);
 void close_file(void* file);
 int read_file(void* file, char* buffer, size_t size);
 int write_file(void* file, const char* buffer, size_t size);
 void rename_file(const char* oldname, const char* newname);
 
+// 8K buffer for large reads, NULL if there is none, valid until block_unmap
+#define BLOCK_SIZE 8192
+char* block_map(void);
+void block_unmap(void);
+
+// Buffered output, written to the file in whole sectors
+void out_open(void* file);
+void out_write(const char* data, size_t size);
+void out_putc(char ch);
+int out_flush(void);
+
+// Buffered input, read in blocks from block_map between in_open and
+// in_close, or by sector if there is no block
+void in_open(void* file);
+void in_close(void);
+size_t in_read(char* data, size_t size);
+int in_getc(void);      // -1 at end of file
+uint32_t in_tell(void); // bytes consumed since in_open
+const char* in_peek(size_t size);
+// Next line without its '\r' or '\n', valid until the next read, NULL at end of file,
+// or NULL with errno set to ENOMEM when the line does not fit in memory
+char* in_line(void);
+
 extern char *filename;
 extern char tmpbuffer[256];
 
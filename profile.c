@@ -0,0 +1,96 @@
+#ifdef PROFILE
+
+#include <stdint.h>
+#include <string.h>
+#include <z80.h>
+#include <arch/zxn.h>
+
+#include "platform.h"
+#include "crtio.h"
+#include "profile.h"
+
+#define CTC0_PORT       0x183b
+#define CTC1_PORT       0x193b
+
+#define CYCLES_PER_FRAME 560000UL   // 28MHz / 50Hz
+#define MAX_FINE_FRAMES 25          // CTC chain wraps every 2^24 cycles (~30 frames)
+
+typedef struct {
+    uint16_t frames;
+    uint16_t fine;                  // CTC count in units of 256 cycles
+} Stamp;
+
+const char * const prof_names[PROF_COUNT] = { "Parse", "Eval", "Render", "I/O" };
+
+static Stamp start[PROF_COUNT];
+static uint8_t depth[PROF_COUNT];
+static uint32_t accum[PROF_COUNT];
+static uint32_t last[PROF_COUNT];
+static uint32_t total[PROF_COUNT];     // never reset, differences stay valid when it wraps
+static Stamp mark;
+
+void prof_init(void) MYCC {
+    z80_outp(CTC0_PORT, 0b00100111);    // Timer, prescaler 256, time constant follows
+    z80_outp(CTC0_PORT, 0);             // 256
+    z80_outp(CTC1_PORT, 0b01000111);    // Counter, clocked by channel 0 ZC/TO
+    z80_outp(CTC1_PORT, 0);             // 256
+}
+
+void prof_shutdown(void) MYCC {
+    z80_outp(CTC0_PORT, 0b00000011);    // Software reset
+    z80_outp(CTC1_PORT, 0b00000011);
+}
+
+static void stamp(Stamp *s) {
+    uint8_t hi, lo;
+    do {
+        s->frames = get_ticks();
+        hi = z80_inp(CTC1_PORT);
+        lo = z80_inp(CTC0_PORT);
+    } while (hi != z80_inp(CTC1_PORT)); // channel 0 wrapped between reads
+    s->fine = ~(((uint16_t)hi << 8) | lo); // down counters, flip to count up
+}
+
+static uint32_t elapsed(const Stamp *from) {
+    Stamp now;
+    stamp(&now);
+    uint16_t frames = now.frames - from->frames;
+    if (frames > MAX_FINE_FRAMES) {
+        return frames * CYCLES_PER_FRAME;
+    }
+    return (uint32_t)(uint16_t)(now.fine - from->fine) << 8;
+}
+
+void prof_begin(uint8_t phase) MYCC {
+    if (depth[phase]++ == 0) stamp(&start[phase]);
+}
+
+void prof_end(uint8_t phase) MYCC {
+    if (!depth[phase] || --depth[phase]) return;
+    uint32_t t = elapsed(&start[phase]);
+    accum[phase] += t;
+    total[phase] += t;
+}
+
+void prof_mark(void) MYCC {
+    stamp(&mark);
+}
+
+uint32_t prof_since_mark(void) MYCC {
+    return elapsed(&mark);
+}
+
+void prof_keystroke(void) MYCC {
+    memcpy(last, accum, sizeof(last));
+    memset(accum, 0, sizeof(accum));
+}
+
+uint32_t prof_last(uint8_t phase) MYCC {
+    return last[phase];
+}
+
+uint32_t prof_total(uint8_t phase) MYCC {
+    return total[phase];
+}
+
+#endif //PROFILE
@@ -0,0 +1,46 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+typedef enum { PROF_PARSE, PROF_EVAL, PROF_RENDER, PROF_IO, PROF_COUNT } PROF_PHASE;
+
+#ifdef PROFILE
+
+// Times are accumulated in 28MHz clock cycles using CTC channels 0 and 1
+// chained as a 16-bit counter, falling back to the frame counter for
+// anything longer than about half a second.
+
+#define PROF_CYCLES_PER_MS  28000
+
+void prof_init(void) MYCC;
+void prof_shutdown(void) MYCC;
+void prof_begin(uint8_t phase) MYCC;
+void prof_end(uint8_t phase) MYCC;
+void prof_keystroke(void) MYCC;
+uint32_t prof_last(uint8_t phase) MYCC;
+uint32_t prof_total(uint8_t phase) MYCC;    // since prof_init, for spans across keystrokes
+
+// Ad hoc measurements outside the phase totals
+void prof_mark(void) MYCC;
+uint32_t prof_since_mark(void) MYCC;
+
+extern const char * const prof_names[PROF_COUNT];
+
+#define PROF_INIT()         prof_init()
+#define PROF_SHUTDOWN()     prof_shutdown()
+#define PROF_BEGIN(p)       prof_begin(p)
+#define PROF_END(p)         prof_end(p)
+#define PROF_KEYSTROKE()    prof_keystroke()
+
+#else
+
+#define PROF_INIT()
+#define PROF_SHUTDOWN()
+#define PROF_BEGIN(p)
+#define PROF_END(p)
+#define PROF_KEYSTROKE()
+
+#endif //PROFILE
+
+#endif //PROFILE_H_
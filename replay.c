@@ -0,0 +1,132 @@
+#ifdef REPLAY
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "platform.h"
+#include "profile.h"
+#include "replay.h"
+
+#define MAX_KEYS    1024    // longest script played or recorded
+
+// Cost of one key in 28MHz cycles
+typedef struct {
+    uint32_t total;
+    uint32_t phase[PROF_COUNT];
+    char key;
+} KeyCost;
+
+char* replay_path;
+char* keys;             // script being played or recorded
+uint16_t key_count;
+uint16_t key_pos;       // next key to play
+uint8_t recording;
+
+KeyCost* costs;         // one per key played, NULL when recording
+KeyCost* timing;        // key being timed
+uint32_t phase_start[PROF_COUNT];
+
+uint8_t replay_open(const char* path) MYCC {
+    replay_path = strdup(path);
+    if (!replay_path) return 0;
+
+    errno = 0;
+    void* f = open_file(path);
+    if (errno) {
+        keys = malloc(MAX_KEYS);
+        recording = 1;
+        return keys != NULL;
+    }
+
+    uint32_t size = file_size(f);
+    key_count = size > MAX_KEYS ? MAX_KEYS : size;
+    keys = malloc(key_count);
+    costs = malloc(key_count * sizeof(KeyCost));
+    if (keys && costs) key_count = read_file(f, keys, key_count);
+    close_file(f);
+    if (!keys || !costs) {
+        key_count = 0;
+        return 0;
+    }
+    return 1;
+}
+
+static char* append_num(char* p, uint32_t n) {
+    *p++ = ' ';
+    ultoa(n, p, 10);
+    return p + strlen(p);
+}
+
+// One line per key: key code, then total, parse, eval, render and I/O cycles
+static void write_log(void) {
+    strcpy(tmpbuffer, replay_path);
+    strcat(tmpbuffer, ".log");
+
+    errno = 0;
+    void* f = create_file(tmpbuffer);
+    if (errno) return;
+    for (uint16_t i = 0; i < key_pos && !errno; ++i) {
+        KeyCost* k = &costs[i];
+        char* p = tmpbuffer;
+        utoa((uint8_t)k->key, p, 10);
+        p += strlen(p);
+        p = append_num(p, k->total);
+        for (uint8_t ph = 0; ph < PROF_COUNT; ++ph) p = append_num(p, k->phase[ph]);
+        *p++ = '\r';
+        *p++ = '\n';
+        write_file(f, tmpbuffer, p - tmpbuffer);
+    }
+    close_file(f);
+}
+
+void replay_close(void) MYCC {
+    replay_end();
+    if (recording) {
+        errno = 0;
+        void* f = create_file(replay_path);
+        if (!errno) {
+            write_file(f, keys, key_count);
+            close_file(f);
+        }
+    }
+    else if (costs) {
+        write_log();
+    }
+    free(replay_path);
+    free(keys);
+    free(costs);
+    replay_path = keys = NULL;
+    costs = NULL;
+    key_count = key_pos = 0;
+    recording = 0;
+}
+
+char replay_next(void) MYCC {
+    if (recording || !keys) return 0;
+    if (key_pos < key_count) return keys[key_pos++];
+    replay_close(); // played out, back to the keyboard
+    return 0;
+}
+
+void replay_capture(char key) MYCC {
+    if (recording && key_count < MAX_KEYS) keys[key_count++] = key;
+}
+
+void replay_begin(char key) MYCC {
+    if (!costs || !key_pos) return;
+    timing = &costs[key_pos - 1];
+    timing->key = key;
+    for (uint8_t ph = 0; ph < PROF_COUNT; ++ph) phase_start[ph] = prof_total(ph);
+    prof_mark();
+}
+
+void replay_end(void) MYCC {
+    if (!timing) return;
+    timing->total = prof_since_mark();
+    for (uint8_t ph = 0; ph < PROF_COUNT; ++ph) timing->phase[ph] = prof_total(ph) - phase_start[ph];
+    timing = NULL;
+}
+
+#endif //REPLAY
@@ -0,0 +1,32 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdint.h>
+
+#ifdef REPLAY
+
+// Keystroke replay, built with make REPLAY=1 (which implies PROFILE).
+//
+// .sheet -r keys.rpl [file] feeds getch from keys.rpl, one byte per key
+// as getch returns it, and writes the cost of each key to keys.rpl.log.
+// A key is timed from getch returning it to the end of the next print_view,
+// or to the next getch for keys read by edit_line and prompts. If keys.rpl
+// does not exist the keys typed are recorded to it instead, on quit.
+
+uint8_t replay_open(const char* path) MYCC; // 0 if out of memory
+void replay_close(void) MYCC;
+
+char replay_next(void) MYCC;            // next key of the script, 0 when there is none
+void replay_capture(char key) MYCC;     // live key, kept when recording
+void replay_begin(char key) MYCC;
+void replay_end(void) MYCC;
+
+#define REPLAY_END()    replay_end()
+
+#else
+
+#define REPLAY_END()
+
+#endif //REPLAY
+
+#endif //REPLAY_H_
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "platform.h"
+
+#define IO_BUFFER_SIZE 512     // one SD card sector
+
+// Only one stream is open at a time, so input and output share the buffer
+char io_buffer[IO_BUFFER_SIZE];
+
+void* out_file;
+uint16_t out_len;
+
+char* in_buffer;
+uint16_t in_size;
+
+void* in_file;
+uint16_t in_pos;
+uint16_t in_len;
+uint32_t in_total;      // bytes read since in_open
+
+char* in_carry;         // line that spans a buffer refill
+size_t in_carry_len;
+size_t in_carry_size;
+
+void out_open(void* file) {
+    out_file = file;
+    out_len = 0;
+}
+
+void out_write(const char* data, size_t size) {
+    while (size) {
+        size_t n = IO_BUFFER_SIZE - out_len;
+        if (n > size) n = size;
+        memcpy(io_buffer + out_len, data, n);
+        out_len += n;
+        data += n;
+        size -= n;
+        if (out_len == IO_BUFFER_SIZE) {
+            write_file(out_file, io_buffer, IO_BUFFER_SIZE);
+            out_len = 0;
+        }
+    }
+}
+
+void out_putc(char ch) {
+    io_buffer[out_len++] = ch;
+    if (out_len == IO_BUFFER_SIZE) {
+        write_file(out_file, io_buffer, IO_BUFFER_SIZE);
+        out_len = 0;
+    }
+}
+
+int out_flush(void) {
+    if (out_len) {
+        write_file(out_file, io_buffer, out_len);
+        out_len = 0;
+    }
+    return errno;
+}
+
+void in_open(void* file) {
+    in_file = file;
+    in_pos = in_len = 0;
+    in_total = 0;
+    // read in whole blocks when the platform has room, parsed in place
+    in_buffer = block_map();
+    in_size = BLOCK_SIZE;
+    if (!in_buffer) {
+        in_buffer = io_buffer;
+        in_size = IO_BUFFER_SIZE;
+    }
+    free(in_carry);
+    in_carry = NULL;
+    in_carry_len = in_carry_size = 0;
+}
+
+void in_close(void) {
+    if (in_buffer != io_buffer) block_unmap();
+}
+
+static void in_fill(void) {
+    int bytes = read_file(in_file, in_buffer, in_size);
+    in_len = bytes > 0 ? bytes : 0;
+    in_pos = 0;
+    in_total += in_len;
+}
+
+size_t in_read(char* data, size_t size) {
+    size_t total = 0;
+    while (size) {
+        if (in_pos == in_len) {
+            in_fill();
+            if (!in_len) break;
+        }
+        size_t n = in_len - in_pos;
+        if (n > size) n = size;
+        memcpy(data, in_buffer + in_pos, n);
+        in_pos += n;
+        data += n;
+        size -= n;
+        total += n;
+    }
+    return total;
+}
+
+uint32_t in_tell(void) {
+    return in_total - (in_len - in_pos);
+}
+
+int in_getc(void) {
+    if (in_pos == in_len) {
+        in_fill();
+        if (!in_len) return -1;
+    }
+    return (uint8_t)in_buffer[in_pos++];
+}
+
+const char* in_peek(size_t size) {
+    if (in_pos == in_len) in_fill();
+    if ((size_t)(in_len - in_pos) < size) return NULL;
+    return in_buffer + in_pos;
+}
+
+// Append to the carried line, returns 0 with errno set to ENOMEM and the
+// line dropped when it does not fit in memory
+static uint8_t in_carry_append(const char* data, size_t size) {
+    if (in_carry_len + size + 1 > in_carry_size) {
+        size_t n = in_carry_len + size + 1 + 32;
+        char* p = realloc(in_carry, n);
+        if (!p) {
+            in_carry_len = 0;
+            errno = ENOMEM;
+            return 0;
+        }
+        in_carry = p;
+        in_carry_size = n;
+    }
+    memcpy(in_carry + in_carry_len, data, size);
+    in_carry_len += size;
+    in_carry[in_carry_len] = 0;
+    return 1;
+}
+
+char* in_line(void) {
+    for (;;) {
+        if (in_pos == in_len) {
+            in_fill();
+            if (!in_len) {
+                if (!in_carry_len) return NULL;
+                in_carry_len = 0;
+                return in_carry;
+            }
+        }
+        char* start = in_buffer + in_pos;
+        char* end = in_buffer + in_len;
+        char* p = start;
+        while (p < end && *p != '\r' && *p != '\n') ++p;
+        if (p == end) {
+            in_pos = in_len;
+            if (!in_carry_append(start, p - start)) return NULL;
+            continue;
+        }
+        *p = 0;
+        in_pos = p + 1 - in_buffer;
+        if (!in_carry_len) return start;
+        if (!in_carry_append(start, p - start)) return NULL;
+        in_carry_len = 0;
+        return in_carry;
+    }
+}